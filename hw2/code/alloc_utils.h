@@ -0,0 +1,160 @@
+#ifndef _ALLOC_UTILS_H
+#define _ALLOC_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <errno.h>
+
+#define HUGE_PAGE_SIZE (2u * 1024 * 1024)
+#define MAX_NUMA_NODES 64
+
+typedef enum
+{
+    HUGEPAGE_NONE,
+    HUGEPAGE_THP,     // madvise(MADV_HUGEPAGE) on a 2 MiB aligned mapping
+    HUGEPAGE_HUGETLB  // MAP_HUGETLB from the reserved pool, falls back to THP when it is empty
+} hugepage_mode_t;
+
+typedef struct
+{
+    hugepage_mode_t hugepages;
+    int populate;   // pre-fault every page at allocation time
+    int interleave; // spread pages over all online NUMA nodes
+} alloc_policy_t;
+
+// What alloc_buffer actually handed out, needed to release it
+typedef struct
+{
+    void *base;
+    size_t length;
+    hugepage_mode_t hugepages;
+} buffer_t;
+
+const char *hugepage_names[] = {"none", "thp", "hugetlb"};
+
+int parse_hugepage_mode(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(hugepage_names) / sizeof(hugepage_names[0])); i++)
+        if (strcmp(name, hugepage_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+// Online nodes from sysfs ("0-3,6") as a bit mask; 0 when the machine is not NUMA
+unsigned long numa_online_mask()
+{
+    FILE *file = fopen("/sys/devices/system/node/online", "r");
+    if (file == NULL)
+        return 0;
+    unsigned long mask = 0;
+    int lo, hi;
+    char separator;
+    while (fscanf(file, "%d", &lo) == 1)
+    {
+        hi = lo;
+        if (fscanf(file, "%c", &separator) == 1 && separator == '-')
+        {
+            if (fscanf(file, "%d", &hi) != 1)
+                break;
+            if (fscanf(file, "%c", &separator) != 1)
+                separator = '\n';
+        }
+        for (int node = lo; node <= hi && node < MAX_NUMA_NODES; node++)
+            mask |= 1UL << node;
+        if (separator != ',')
+            break;
+    }
+    fclose(file);
+    return mask;
+}
+
+// Pre-faults a writable mapping. MADV_POPULATE_WRITE needs 5.14 headers to build and a 5.14
+// kernel to succeed; otherwise one byte per page is touched instead.
+void populate_buffer(void *base, size_t length)
+{
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(base, length, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (size_t offset = 0; offset < length; offset += page_size)
+        ((volatile char *)base)[offset] = 0;
+}
+
+// Applies the huge page, NUMA and pre-fault parts of the policy to an existing mapping, e.g.
+// one that came from shm_open. Advice the kernel rejects is reported and otherwise ignored.
+void advise_buffer(void *base, size_t length, const alloc_policy_t *policy)
+{
+    if (policy->hugepages != HUGEPAGE_NONE && madvise(base, length, MADV_HUGEPAGE) == -1)
+        perror("madvise(MADV_HUGEPAGE) failed");
+    if (policy->interleave)
+    {
+        unsigned long mask = numa_online_mask();
+        if (mask != 0 && syscall(SYS_mbind, base, length, MPOL_INTERLEAVE, &mask, MAX_NUMA_NODES, 0) == -1)
+            perror("mbind(MPOL_INTERLEAVE) failed");
+    }
+    if (policy->populate)
+        populate_buffer(base, length);
+}
+
+// Anonymous, page-aligned allocation following the policy; returns 0 or -1
+int alloc_buffer(buffer_t *buffer, size_t size, const alloc_policy_t *policy)
+{
+    buffer->hugepages = policy->hugepages;
+    if (policy->hugepages == HUGEPAGE_HUGETLB)
+    {
+        buffer->length = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (policy->populate ? MAP_POPULATE : 0);
+        buffer->base = mmap(NULL, buffer->length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (buffer->base != MAP_FAILED)
+        {
+            alloc_policy_t rest = *policy;
+            rest.hugepages = HUGEPAGE_NONE;
+            rest.populate = 0; // MAP_POPULATE already did it
+            advise_buffer(buffer->base, buffer->length, &rest);
+            return 0;
+        }
+        fprintf(stderr, "MAP_HUGETLB failed (%s), falling back to transparent huge pages\n", strerror(errno));
+        buffer->hugepages = HUGEPAGE_THP;
+    }
+
+    // Over-map by one huge page and trim, so THP can back the buffer from its first byte
+    long page_size = sysconf(_SC_PAGESIZE);
+    size = (size + page_size - 1) / page_size * page_size;
+    size_t align = buffer->hugepages == HUGEPAGE_THP ? HUGE_PAGE_SIZE : 0;
+    size_t length = size + align;
+    char *raw = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return -1;
+    char *base = raw;
+    if (align != 0)
+    {
+        base = (char *)(((uintptr_t)raw + align - 1) & ~(uintptr_t)(align - 1));
+        if (base > raw)
+            munmap(raw, base - raw);
+        size_t tail = (raw + length) - (base + size);
+        if (tail > 0)
+            munmap(base + size, tail);
+    }
+    buffer->base = base;
+    buffer->length = size;
+    alloc_policy_t effective = *policy;
+    effective.hugepages = buffer->hugepages;
+    advise_buffer(buffer->base, buffer->length, &effective);
+    return 0;
+}
+
+void free_buffer(buffer_t *buffer)
+{
+    if (buffer->base != NULL && munmap(buffer->base, buffer->length) == -1)
+        perror("Failed to unmap buffer");
+    buffer->base = NULL;
+}
+
+#endif
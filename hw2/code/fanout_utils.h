@@ -0,0 +1,315 @@
+#ifndef _FANOUT_UTILS_H
+#define _FANOUT_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "fifo_utils.h"
+#include "shm_utils.h"
+#include "stream_utils.h"
+#include "kernel_utils.h"
+#include "input_utils.h"
+
+#define MAX_WORKERS 128
+
+// Partial result travelling up the reduction tree. The product wraps modulo 2^64 (or is taken
+// modulo a prime) so that combining partials in tree order gives the same value as the
+// sequential loop.
+typedef struct
+{
+    __int128 sum; // 64-bit inputs can overflow an int64 sum
+    uint64_t product;
+} partial_t;
+
+// Slice assignment sent to a worker over its data pipe
+typedef struct
+{
+    int64_t lo;
+    int64_t hi;
+    shm_descriptor_t shm;       // empty name: the slice follows as a chunk stream
+    input_descriptor_t input;   // non-empty path: the worker maps its slice of the file
+} slice_message_t;
+
+typedef struct
+{
+    const int *numbers;
+    int64_t arr_size;
+    const input_descriptor_t *input; // set: slices are file ranges, numbers is unused
+    int workers;
+    const char *shm_name; // NULL streams the slices over the data pipes
+    size_t chunk_size;
+    uint64_t modulus; // 0 multiplies modulo 2^64
+    int zero_copy;    // vmsplice the slices into the data pipes
+} fanout_job_t;
+
+typedef struct
+{
+    partial_t partial;
+    uint64_t modulus;
+} fanout_fold_t;
+
+void combine_partials(partial_t *acc, const partial_t *other, uint64_t modulus)
+{
+    acc->sum += other->sum;
+    if (modulus != 0)
+        acc->product = mulmod(acc->product, other->product, modulus);
+    else
+        acc->product *= other->product;
+}
+
+void fold_partial(const int *values, size_t count, void *ctx)
+{
+    fanout_fold_t *fold = (fanout_fold_t *)ctx;
+    partial_t chunk;
+    chunk.sum = sum_i32(values, count);
+    if (fold->modulus != 0)
+        chunk.product = product_mod_i32(values, count, fold->modulus);
+    else
+        chunk.product = product_wrap_i32(values, count);
+    combine_partials(&fold->partial, &chunk, fold->modulus);
+}
+
+void fold_partial_i64(const int64_t *values, size_t count, void *ctx)
+{
+    fanout_fold_t *fold = (fanout_fold_t *)ctx;
+    partial_t chunk;
+    chunk.sum = sum_i64(values, count);
+    if (fold->modulus != 0)
+        chunk.product = product_mod_i64(values, count, fold->modulus);
+    else
+        chunk.product = product_wrap_i64(values, count);
+    combine_partials(&fold->partial, &chunk, fold->modulus);
+}
+
+void fanout_worker(int id, int workers, int data_fd, int (*result_pipes)[2], size_t chunk_size, uint64_t modulus)
+{
+    fanout_fold_t fold = {{0, modulus != 0 ? 1 % modulus : 1}, modulus};
+    slice_message_t slice;
+
+    //--- Compute the partial result of the assigned slice ---------------------------------
+    if (read_fifo_with_retry(data_fd, &slice, sizeof(slice)) != sizeof(slice))
+    {
+        perror("Worker failed to read its slice");
+        exit(EXIT_FAILURE);
+    }
+    if (slice.input.path[0] != '\0')
+    {
+        if (fold_input_range(&slice.input, slice.lo, slice.hi, fold_partial, fold_partial_i64, &fold) == -1)
+        {
+            perror("Worker failed to map its slice");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (slice.shm.shm_name[0] != '\0')
+    {
+        const int *numbers = attach_shm_array(slice.shm.shm_name, slice.shm.arr_size);
+        if (numbers == NULL)
+            exit(EXIT_FAILURE);
+        fold_partial(numbers + slice.lo, slice.hi - slice.lo, &fold);
+        detach_shm_array(numbers, slice.shm.arr_size);
+    }
+    else if (receive_stream(data_fd, chunk_size, fold_partial, &fold) != slice.hi - slice.lo)
+    {
+        perror("Worker failed to receive its slice");
+        exit(EXIT_FAILURE);
+    }
+    close_fd(data_fd);
+    partial_t acc = fold.partial;
+
+    //--- Reduce: at level `step`, odd multiples of step hand their partial to id - step ---
+    for (int step = 1; step < workers; step <<= 1)
+    {
+        if (id % (2 * step) != 0)
+            break;
+        if (id + step < workers)
+        {
+            partial_t peer;
+            if (read_fifo_with_retry(result_pipes[id + step][0], &peer, sizeof(peer)) != sizeof(peer))
+            {
+                perror("Worker failed to read a partial result");
+                exit(EXIT_FAILURE);
+            }
+            combine_partials(&acc, &peer, modulus);
+        }
+    }
+
+    // Worker 0 hands the final value to the parent through the same kind of pipe
+    if (write_fifo_with_retry(result_pipes[id][1], &acc, sizeof(acc)) == -1)
+        exit(EXIT_FAILURE);
+    exit(EXIT_SUCCESS);
+}
+
+// In the reduction tree, child hands its partial to parent at the level step = child - parent
+static int is_tree_child(int parent, int child)
+{
+    int step = child - parent;
+    return step > 0 && (step & (step - 1)) == 0 && parent % (2 * step) == 0;
+}
+
+// Writes every worker's slice at once: the data pipes are non-blocking and a poll loop feeds
+// whichever workers have room, so no worker idles while the parent fills another's pipe
+static int feed_workers(const fanout_job_t *job, int (*data_pipes)[2], const slice_message_t *slices)
+{
+    int workers = job->workers;
+    int streaming = job->shm_name == NULL && job->input == NULL;
+    stream_writer_t writers[MAX_WORKERS];
+    int ready[MAX_WORKERS];
+    int status = 0, remaining = workers;
+    signal(SIGPIPE, SIG_IGN); // a worker that exited early shows up as EPIPE on its pipe
+    for (int i = 0; i < workers; i++)
+    {
+        if (fcntl(data_pipes[i][1], F_SETFL, fcntl(data_pipes[i][1], F_GETFL) | O_NONBLOCK) == -1)
+        {
+            perror("Failed to make a data pipe non-blocking");
+            return -1;
+        }
+        stream_writer_init(&writers[i], data_pipes[i][1], &slices[i], sizeof(slices[i]), job->numbers + (streaming ? slices[i].lo : 0),
+                           slices[i].hi - slices[i].lo, job->chunk_size, streaming, job->zero_copy);
+        ready[i] = 1;
+    }
+
+    while (remaining > 0)
+    {
+        struct pollfd fds[MAX_WORKERS];
+        int owners[MAX_WORKERS];
+        int count = 0;
+        for (int i = 0; i < workers; i++)
+        {
+            if (writers[i].stage == WRITER_DONE || writers[i].fd == -1)
+                continue;
+            int rc = ready[i] ? stream_writer_step(&writers[i]) : 0;
+            if (rc != 0)
+            {
+                if (rc == -1)
+                {
+                    perror("Failed to send a slice to a worker");
+                    status = -1;
+                }
+                close_fd(writers[i].fd);
+                writers[i].fd = -1;
+                remaining--;
+                continue;
+            }
+            fds[count].fd = writers[i].fd;
+            fds[count].events = POLLOUT;
+            owners[count++] = i;
+        }
+        if (count == 0)
+            break;
+        if (poll(fds, count, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll failed");
+            return -1;
+        }
+        for (int i = 0; i < workers; i++)
+            ready[i] = 0;
+        for (int k = 0; k < count; k++)
+            ready[owners[k]] = fds[k].revents != 0;
+    }
+    return status;
+}
+
+// Forks job->workers processes, gives each a contiguous slice and collects the reduced result
+int run_fanout(const fanout_job_t *job, partial_t *result)
+{
+    int workers = job->workers;
+    int data_pipes[MAX_WORKERS][2];
+    int result_pipes[MAX_WORKERS][2];
+    pid_t pids[MAX_WORKERS];
+
+    for (int i = 0; i < workers; i++)
+    {
+        if (pipe(data_pipes[i]) == -1 || pipe(result_pipes[i]) == -1)
+        {
+            perror("Failed to create worker pipes");
+            return -1;
+        }
+    }
+
+    fflush(stdout);
+    for (int i = 0; i < workers; i++)
+    {
+        pids[i] = fork();
+        if (pids[i] < 0)
+        {
+            perror("Failed to fork worker");
+            return -1;
+        }
+        if (pids[i] == 0)
+        {
+            // Keep only this worker's data pipe, its own result writer and its tree children's
+            // readers, so a dead child's EOF is not hidden by a sibling holding its reader
+            for (int j = 0; j < workers; j++)
+            {
+                close(data_pipes[j][1]);
+                if (j != i)
+                    close(data_pipes[j][0]);
+                if (j != i)
+                    close(result_pipes[j][1]);
+                if (!is_tree_child(i, j))
+                    close(result_pipes[j][0]);
+            }
+            fanout_worker(i, workers, data_pipes[i][0], result_pipes, job->chunk_size, job->modulus);
+        }
+    }
+
+    for (int i = 0; i < workers; i++)
+    {
+        close_fd(data_pipes[i][0]);
+        close_fd(result_pipes[i][1]);
+        if (i != 0)
+            close_fd(result_pipes[i][0]);
+    }
+
+    //--- Hand out slices ------------------------------------------------------------------
+    slice_message_t slices[MAX_WORKERS];
+    for (int i = 0; i < workers; i++)
+    {
+        slice_message_t *slice = &slices[i];
+        memset(slice, 0, sizeof(*slice));
+        slice->lo = job->arr_size * i / workers;
+        slice->hi = job->arr_size * (i + 1) / workers;
+        if (job->input != NULL)
+            slice->input = *job->input;
+        else if (job->shm_name != NULL)
+        {
+            snprintf(slice->shm.shm_name, SHM_NAME_SIZE, "%s", job->shm_name);
+            slice->shm.arr_size = job->arr_size;
+        }
+    }
+    int status = feed_workers(job, data_pipes, slices);
+
+    //--- Collect the root of the reduction tree -------------------------------------------
+    if (read_fifo_with_retry(result_pipes[0][0], result, sizeof(*result)) != sizeof(*result))
+    {
+        perror("Failed to read the reduced result");
+        status = -1;
+    }
+    close_fd(result_pipes[0][0]);
+
+    for (int i = 0; i < workers; i++)
+    {
+        int worker_status;
+        while (waitpid(pids[i], &worker_status, 0) == -1)
+        {
+            if (errno != EINTR)
+            {
+                perror("waitpid failed");
+                return -1;
+            }
+        }
+        if (!WIFEXITED(worker_status) || WEXITSTATUS(worker_status) != 0)
+            status = -1;
+    }
+    return status;
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef _FIFO_UTILS_H
+#define _FIFO_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+void create_fifo(const char *fifo_path)
+{
+    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+    if (access(fifo_path, F_OK) == -1)
+    {
+        if (mkfifo(fifo_path, mode) == -1)
+        {
+            perror("Failed to create FIFO");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int open_fifo_with_retry(const char *fifo_path, int flags)
+{
+    int fd;
+    do
+    {
+        fd = open(fifo_path, flags);
+        if (fd == -1 && errno != EINTR)
+        {
+            perror("Failed to open FIFO");
+            return -1;
+        }
+    } while (fd == -1);
+    return fd;
+}
+
+// Reads until count bytes arrived or the writer closed the FIFO; returns the bytes read
+ssize_t read_fifo_with_retry(int fd, void *buf, size_t count)
+{
+    size_t total = 0;
+    while (total < count)
+    {
+        ssize_t bytes_read = read(fd, (char *)buf + total, count - total);
+        if (bytes_read == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Failed to read from FIFO");
+            return -1;
+        }
+        if (bytes_read == 0)
+            break;
+        total += bytes_read;
+    }
+    return total;
+}
+
+// Writes all count bytes, resuming after short writes and interrupts
+ssize_t write_fifo_with_retry(int fd, const void *buf, size_t count)
+{
+    size_t total = 0;
+    while (total < count)
+    {
+        ssize_t bytes_written = write(fd, (const char *)buf + total, count - total);
+        if (bytes_written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Failed to write to FIFO");
+            return -1;
+        }
+        total += bytes_written;
+    }
+    return total;
+}
+
+void remove_fifo(const char *fifo_path)
+{
+    if (unlink(fifo_path) == -1)
+    {
+        perror("Failed to remove FIFO");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void close_fd(int fd)
+{
+    if (close(fd) == -1)
+    {
+        perror("Failed to close file descriptor");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void print(const char *message)
+{
+    ssize_t bytes_written;
+    while (((bytes_written = write(STDOUT_FILENO, message, strlen(message))) == -1) && errno == EINTR)
+        ;
+    if (bytes_written == -1)
+    {
+        perror("Error while writing to stdout.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef _GEN_UTILS_H
+#define _GEN_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "fifo_utils.h"
+
+#define MAX_GEN_THREADS 64
+#define GEN_BLOCK_VALUES (64 * 1024)
+#define SAMPLE_COUNT 16
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+
+typedef enum
+{
+    OUTPUT_ALL,
+    OUTPUT_NONE,
+    OUTPUT_SUMMARY,
+    OUTPUT_SAMPLE,
+    OUTPUT_BINARY
+} output_mode_t;
+
+//--- xoshiro256** -------------------------------------------------------------------------------
+
+typedef struct
+{
+    uint64_t s[4];
+} xoshiro_t;
+
+uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void xoshiro_seed(xoshiro_t *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro_next(xoshiro_t *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+//--- Parallel fill ------------------------------------------------------------------------------
+
+typedef struct
+{
+    int *numbers;
+    size_t count;
+    uint32_t bound;
+    uint64_t seed;
+    size_t first_block;
+    size_t last_block;
+} gen_task_t;
+
+// Each block of GEN_BLOCK_VALUES has its own stream derived from (seed, block index), so the
+// array depends only on the seed, not on how many threads filled it
+void *gen_blocks(void *arg)
+{
+    gen_task_t *task = (gen_task_t *)arg;
+    for (size_t block = task->first_block; block < task->last_block; block++)
+    {
+        xoshiro_t rng;
+        xoshiro_seed(&rng, task->seed ^ (block * 0xD1B54A32D192ED03ULL));
+        size_t lo = block * GEN_BLOCK_VALUES;
+        size_t hi = lo + GEN_BLOCK_VALUES < task->count ? lo + GEN_BLOCK_VALUES : task->count;
+        // Multiply-shift maps the top 32 bits onto [0, bound) without a division
+        for (size_t i = lo; i < hi; i++)
+            task->numbers[i] = (int)(((xoshiro_next(&rng) >> 32) * task->bound) >> 32);
+    }
+    return NULL;
+}
+
+// Fills numbers with values in [0, bound) using up to `threads` threads; returns 0 or -1
+int generate_numbers(int *numbers, size_t count, uint32_t bound, uint64_t seed, int threads)
+{
+    size_t blocks = (count + GEN_BLOCK_VALUES - 1) / GEN_BLOCK_VALUES;
+    if (threads > MAX_GEN_THREADS)
+        threads = MAX_GEN_THREADS;
+    if ((size_t)threads > blocks)
+        threads = blocks > 0 ? (int)blocks : 1;
+
+    pthread_t tids[MAX_GEN_THREADS];
+    gen_task_t tasks[MAX_GEN_THREADS];
+    int status = 0;
+    for (int i = 0; i < threads; i++)
+    {
+        tasks[i] = (gen_task_t){numbers, count, bound, seed, blocks * i / threads, blocks * (i + 1) / threads};
+        // The calling thread takes the first share itself
+        if (i > 0 && pthread_create(&tids[i], NULL, gen_blocks, &tasks[i]) != 0)
+        {
+            gen_blocks(&tasks[i]);
+            tids[i] = 0;
+        }
+    }
+    gen_blocks(&tasks[0]);
+    for (int i = 1; i < threads; i++)
+        if (tids[i] != 0 && pthread_join(tids[i], NULL) != 0)
+            status = -1;
+    return status;
+}
+
+//--- Output -------------------------------------------------------------------------------------
+
+// Formats value into buf without a terminator; returns its length
+size_t format_int(char *buf, int value)
+{
+    char digits[12];
+    size_t length = 0, n = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do
+    {
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0)
+        buf[length++] = '-';
+    while (n > 0)
+        buf[length++] = digits[--n];
+    return length;
+}
+
+// Writes "Numbers: a b c ...\n" through a large buffer instead of one printf per value
+int print_numbers_all(const int *numbers, size_t count)
+{
+    char *buffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+    if (buffer == NULL)
+        return -1;
+    size_t used = 0;
+    memcpy(buffer, "Numbers: ", 9);
+    used = 9;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (used > OUTPUT_BUFFER_SIZE - 16)
+        {
+            if (write_fifo_with_retry(STDOUT_FILENO, buffer, used) == -1)
+                break;
+            used = 0;
+        }
+        used += format_int(buffer + used, numbers[i]);
+        buffer[used++] = ' ';
+    }
+    buffer[used++] = '\n';
+    int status = write_fifo_with_retry(STDOUT_FILENO, buffer, used) == -1 ? -1 : 0;
+    free(buffer);
+    return status;
+}
+
+int write_numbers_binary(const char *path, const int *numbers, size_t count)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1)
+    {
+        perror("Failed to open output file");
+        return -1;
+    }
+    int status = write_fifo_with_retry(fd, numbers, count * sizeof(int)) == -1 ? -1 : 0;
+    if (close(fd) == -1)
+        status = -1;
+    return status;
+}
+
+// Reports the array according to mode; binary_path is only used by OUTPUT_BINARY
+int output_numbers(output_mode_t mode, const int *numbers, size_t count, const char *binary_path)
+{
+    char buffer[256];
+    fflush(stdout); // everything below bypasses stdio
+    switch (mode)
+    {
+    case OUTPUT_NONE:
+        return 0;
+    case OUTPUT_ALL:
+        return print_numbers_all(numbers, count);
+    case OUTPUT_SAMPLE:
+    {
+        print("Numbers (sampled):");
+        size_t samples = count < SAMPLE_COUNT ? count : SAMPLE_COUNT;
+        for (size_t i = 0; i < samples; i++)
+        {
+            size_t index = samples > 1 ? i * (count - 1) / (samples - 1) : 0;
+            snprintf(buffer, sizeof(buffer), " [%zu]=%d", index, numbers[index]);
+            print(buffer);
+        }
+        print("\n");
+        return 0;
+    }
+    case OUTPUT_SUMMARY:
+    {
+        int64_t sum = 0;
+        int min = count > 0 ? numbers[0] : 0, max = min;
+        for (size_t i = 0; i < count; i++)
+        {
+            sum += numbers[i];
+            if (numbers[i] < min)
+                min = numbers[i];
+            if (numbers[i] > max)
+                max = numbers[i];
+        }
+        snprintf(buffer, sizeof(buffer), "Numbers: %zu values, min %d, max %d, sum %lld\n", count, min, max, (long long)sum);
+        print(buffer);
+        return 0;
+    }
+    case OUTPUT_BINARY:
+        if (write_numbers_binary(binary_path, numbers, count) == -1)
+            return -1;
+        snprintf(buffer, sizeof(buffer), "Numbers: %zu values written to '%s'\n", count, binary_path);
+        print(buffer);
+        return 0;
+    }
+    return 0;
+}
+
+#endif
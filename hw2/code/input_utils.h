@@ -0,0 +1,97 @@
+#ifndef _INPUT_UTILS_H
+#define _INPUT_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include "stream_utils.h"
+
+#define INPUT_PATH_SIZE 256
+#define FILE_WINDOW_BYTES (64u * 1024 * 1024)
+
+// Sent over the FIFOs / worker pipes instead of the data itself: every reader maps the
+// part of the file it needs, so the dataset never passes through the parent
+typedef struct
+{
+    char path[INPUT_PATH_SIZE];
+    int32_t element_size; // 4 or 8
+    int32_t reserved;
+    int64_t count;
+} input_descriptor_t;
+
+typedef void (*fold_i64_fn)(const int64_t *values, size_t count, void *ctx);
+
+// Validates a raw native-endian int32/int64 file; returns 0 or -1
+int open_input_file(const char *path, int element_size, input_descriptor_t *input)
+{
+    if (strlen(path) >= INPUT_PATH_SIZE)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    struct stat st;
+    int status = fstat(fd, &st);
+    close(fd);
+    if (status == -1)
+        return -1;
+    if (!S_ISREG(st.st_mode) || st.st_size % element_size != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(input, 0, sizeof(*input));
+    snprintf(input->path, INPUT_PATH_SIZE, "%s", path);
+    input->element_size = element_size;
+    input->count = st.st_size / element_size;
+    return 0;
+}
+
+// Folds elements [lo, hi) of the file through FILE_WINDOW_BYTES read-only mappings, unmapping
+// each window before the next so resident memory stays bounded whatever the file size.
+// Returns the number of values folded or -1.
+int64_t fold_input_range(const input_descriptor_t *input, int64_t lo, int64_t hi, chunk_fold_fn fold32, fold_i64_fn fold64, void *ctx)
+{
+    int fd = open(input->path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    off_t page_size = sysconf(_SC_PAGESIZE);
+    off_t offset = (off_t)lo * input->element_size;
+    off_t end = (off_t)hi * input->element_size;
+    while (offset < end)
+    {
+        // Mappings start on a page boundary; pages are a multiple of the element size, so
+        // every window holds whole elements
+        off_t map_start = offset - offset % page_size;
+        size_t map_length = end - map_start < (off_t)FILE_WINDOW_BYTES ? (size_t)(end - map_start) : FILE_WINDOW_BYTES;
+        char *window = (char *)mmap(NULL, map_length, PROT_READ, MAP_SHARED, fd, map_start);
+        if (window == MAP_FAILED)
+        {
+            close(fd);
+            return -1;
+        }
+        madvise(window, map_length, MADV_SEQUENTIAL);
+
+        size_t skip = offset - map_start;
+        size_t values = (map_length - skip) / input->element_size;
+        if (input->element_size == sizeof(int64_t))
+            fold64((const int64_t *)(window + skip), values, ctx);
+        else
+            fold32((const int *)(window + skip), values, ctx);
+        munmap(window, map_length);
+        offset += values * input->element_size;
+    }
+    close(fd);
+    return hi - lo;
+}
+
+#endif
@@ -0,0 +1,623 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <mqueue.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "fifo_utils.h"
+#include "timing_utils.h"
+
+#define MIN_PAYLOAD (4ULL * 1024)
+#define MAX_PAYLOAD (4ULL * 1024 * 1024 * 1024)
+#define MAX_CHUNK_SIZES 16
+#define IPC_PATH_SIZE 108
+#define MQ_MAX_MESSAGES 8
+#define ATTACH_TIMEOUT_MS 5000
+
+typedef enum
+{
+    SIDE_SENDER,
+    SIDE_RECEIVER
+} side_t;
+
+// Shared-memory channel: two slots handed back and forth with process-shared semaphores
+typedef struct
+{
+    sem_t full[2];
+    sem_t empty[2];
+    size_t length[2];
+} shm_ring_t;
+
+typedef struct
+{
+    size_t chunk;
+    char path[IPC_PATH_SIZE];
+    int fds[2];
+    int fd;
+    mqd_t mq;
+    shm_ring_t *ring;
+    char *slots;
+    size_t ring_size;
+    int slot;
+} channel_t;
+
+// Filled in by the receiver: one-way latency from send stamp to the message's last byte arriving
+typedef struct
+{
+    uint64_t samples;
+    double p50_us;
+    double p99_us;
+} latency_report_t;
+
+// prepare runs before fork, attach/detach in each process, cleanup in the parent afterwards.
+// send moves exactly `length` bytes; recv returns the bytes of one read/message or -1.
+typedef struct
+{
+    const char *name;
+    int (*prepare)(channel_t *channel);
+    int (*attach)(channel_t *channel, side_t side);
+    int (*send)(channel_t *channel, const char *buf, size_t length);
+    ssize_t (*recv)(channel_t *channel, char *buf, size_t length);
+    void (*detach)(channel_t *channel, side_t side);
+    void (*cleanup)(channel_t *channel);
+} transport_ops_t;
+
+int run_case(const transport_ops_t *ops, uint64_t payload, size_t chunk, FILE *out);
+int parse_size_list(char *list, size_t *sizes, int max);
+uint64_t parse_size(const char *text);
+uint64_t monotonic_ns();
+int compare_u64(const void *a, const void *b);
+
+//--- Stream transports (FIFO, socketpair, UNIX socket) ------------------------------------------
+
+int stream_send(channel_t *channel, const char *buf, size_t length)
+{
+    return write_fifo_with_retry(channel->fd, buf, length) == -1 ? -1 : 0;
+}
+
+ssize_t stream_recv(channel_t *channel, char *buf, size_t length)
+{
+    ssize_t bytes_read;
+    while ((bytes_read = read(channel->fd, buf, length)) == -1 && errno == EINTR)
+        ;
+    return bytes_read > 0 ? bytes_read : -1;
+}
+
+void stream_detach(channel_t *channel, side_t side)
+{
+    close_fd(channel->fd);
+}
+
+int fifo_prepare(channel_t *channel)
+{
+    snprintf(channel->path, IPC_PATH_SIZE, "/tmp/hw2_ipcbench_%d", (int)getpid());
+    unlink(channel->path);
+    return mkfifo(channel->path, S_IRUSR | S_IWUSR);
+}
+
+// A blocking O_WRONLY open waits forever for a receiver that died before opening its end, so the
+// sender polls a non-blocking open (ENXIO until a reader exists) for at most ATTACH_TIMEOUT_MS
+int fifo_attach(channel_t *channel, side_t side)
+{
+    if (side == SIDE_RECEIVER)
+    {
+        channel->fd = open(channel->path, O_RDONLY);
+        return channel->fd == -1 ? -1 : 0;
+    }
+    for (int waited_ms = 0; (channel->fd = open(channel->path, O_WRONLY | O_NONBLOCK)) == -1; waited_ms++)
+    {
+        if ((errno != ENXIO && errno != EINTR) || waited_ms == ATTACH_TIMEOUT_MS)
+            return -1;
+        usleep(1000);
+    }
+    fcntl(channel->fd, F_SETFL, fcntl(channel->fd, F_GETFL) & ~O_NONBLOCK);
+    return 0;
+}
+
+void path_cleanup(channel_t *channel)
+{
+    unlink(channel->path);
+}
+
+int socketpair_prepare(channel_t *channel)
+{
+    return socketpair(AF_UNIX, SOCK_STREAM, 0, channel->fds);
+}
+
+int socketpair_attach(channel_t *channel, side_t side)
+{
+    channel->fd = channel->fds[side];
+    close_fd(channel->fds[1 - side]);
+    return 0;
+}
+
+void socketpair_cleanup(channel_t *channel)
+{
+    // Both ends were closed by attach/detach in the processes that own them
+}
+
+int unix_prepare(channel_t *channel)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(channel->path, IPC_PATH_SIZE, "/tmp/hw2_ipcbench_%d.sock", (int)getpid());
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", channel->path);
+    unlink(channel->path);
+
+    channel->fds[0] = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (channel->fds[0] == -1)
+        return -1;
+    if (bind(channel->fds[0], (struct sockaddr *)&address, sizeof(address)) == -1 || listen(channel->fds[0], 1) == -1)
+    {
+        close(channel->fds[0]);
+        return -1;
+    }
+    return 0;
+}
+
+// The sender accepts, the receiver connects to the path like an unrelated process would. Like
+// the FIFO open, the accept gives up after ATTACH_TIMEOUT_MS if the receiver never connects.
+int unix_attach(channel_t *channel, side_t side)
+{
+    if (side == SIDE_SENDER)
+    {
+        struct pollfd pfd = {channel->fds[0], POLLIN, 0};
+        int ready;
+        while ((ready = poll(&pfd, 1, ATTACH_TIMEOUT_MS)) == -1 && errno == EINTR)
+            ;
+        while (ready > 0 && (channel->fd = accept(channel->fds[0], NULL, NULL)) == -1 && errno == EINTR)
+            ;
+        close_fd(channel->fds[0]);
+        return channel->fd == -1 ? -1 : 0;
+    }
+    close_fd(channel->fds[0]);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", channel->path);
+    channel->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (channel->fd == -1)
+        return -1;
+    if (connect(channel->fd, (struct sockaddr *)&address, sizeof(address)) == -1)
+    {
+        close(channel->fd);
+        channel->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+//--- POSIX message queue ------------------------------------------------------------------------
+
+int mq_prepare(channel_t *channel)
+{
+    struct mq_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.mq_maxmsg = MQ_MAX_MESSAGES;
+    attr.mq_msgsize = channel->chunk;
+    snprintf(channel->path, IPC_PATH_SIZE, "/hw2_ipcbench_%d", (int)getpid());
+    mq_unlink(channel->path);
+    channel->mq = mq_open(channel->path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, &attr);
+    return channel->mq == (mqd_t)-1 ? -1 : 0;
+}
+
+int mq_attach(channel_t *channel, side_t side)
+{
+    return 0;
+}
+
+int mq_send_message(channel_t *channel, const char *buf, size_t length)
+{
+    while (mq_send(channel->mq, buf, length, 0) == -1)
+        if (errno != EINTR)
+            return -1;
+    return 0;
+}
+
+ssize_t mq_recv_message(channel_t *channel, char *buf, size_t length)
+{
+    ssize_t bytes_read;
+    // mq_receive needs a buffer of the full message size, buf is always chunk bytes long
+    while ((bytes_read = mq_receive(channel->mq, buf, channel->chunk, NULL)) == -1 && errno == EINTR)
+        ;
+    return bytes_read;
+}
+
+void mq_detach(channel_t *channel, side_t side)
+{
+    mq_close(channel->mq);
+}
+
+void mq_cleanup(channel_t *channel)
+{
+    mq_unlink(channel->path);
+}
+
+//--- Shared memory ------------------------------------------------------------------------------
+
+int shm_prepare(channel_t *channel)
+{
+    channel->ring_size = sizeof(shm_ring_t) + 2 * channel->chunk;
+    channel->ring = (shm_ring_t *)mmap(NULL, channel->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (channel->ring == MAP_FAILED)
+        return -1;
+    channel->slots = (char *)(channel->ring + 1);
+    for (int i = 0; i < 2; i++)
+    {
+        if (sem_init(&channel->ring->full[i], 1, 0) == -1 || sem_init(&channel->ring->empty[i], 1, 1) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+int shm_attach(channel_t *channel, side_t side)
+{
+    channel->slot = 0;
+    return 0;
+}
+
+int sem_wait_retry(sem_t *sem)
+{
+    while (sem_wait(sem) == -1)
+        if (errno != EINTR)
+            return -1;
+    return 0;
+}
+
+int shm_send(channel_t *channel, const char *buf, size_t length)
+{
+    int slot = channel->slot;
+    if (sem_wait_retry(&channel->ring->empty[slot]) == -1)
+        return -1;
+    memcpy(channel->slots + slot * channel->chunk, buf, length);
+    channel->ring->length[slot] = length;
+    channel->slot ^= 1;
+    return sem_post(&channel->ring->full[slot]);
+}
+
+// Copies out of the slot so the receiver ends up with its own copy, like the other transports
+ssize_t shm_recv(channel_t *channel, char *buf, size_t length)
+{
+    int slot = channel->slot;
+    if (sem_wait_retry(&channel->ring->full[slot]) == -1)
+        return -1;
+    size_t received = channel->ring->length[slot];
+    memcpy(buf, channel->slots + slot * channel->chunk, received);
+    channel->slot ^= 1;
+    if (sem_post(&channel->ring->empty[slot]) == -1)
+        return -1;
+    return received;
+}
+
+void shm_detach(channel_t *channel, side_t side)
+{
+}
+
+void shm_cleanup(channel_t *channel)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        sem_destroy(&channel->ring->full[i]);
+        sem_destroy(&channel->ring->empty[i]);
+    }
+    munmap(channel->ring, channel->ring_size);
+}
+
+//------------------------------------------------------------------------------------------------
+
+const transport_ops_t transports[] = {
+    {"fifo", fifo_prepare, fifo_attach, stream_send, stream_recv, stream_detach, path_cleanup},
+    {"socketpair", socketpair_prepare, socketpair_attach, stream_send, stream_recv, stream_detach, socketpair_cleanup},
+    {"unix", unix_prepare, unix_attach, stream_send, stream_recv, stream_detach, path_cleanup},
+    {"mqueue", mq_prepare, mq_attach, mq_send_message, mq_recv_message, mq_detach, mq_cleanup},
+    {"shm", shm_prepare, shm_attach, shm_send, shm_recv, shm_detach, shm_cleanup},
+};
+#define TRANSPORT_COUNT (int)(sizeof(transports) / sizeof(transports[0]))
+
+int main(int argc, char *argv[])
+{
+    //--- Check validity of arguments --------------------------------------------------
+    char *transport_list = NULL;
+    uint64_t min_payload = MIN_PAYLOAD, max_payload = MAX_PAYLOAD;
+    size_t chunk_sizes[MAX_CHUNK_SIZES] = {4096, 65536, 1048576};
+    int chunk_count = 3;
+    const char *output_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:S:k:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            transport_list = optarg;
+            break;
+        case 's':
+            min_payload = parse_size(optarg);
+            break;
+        case 'S':
+            max_payload = parse_size(optarg);
+            break;
+        case 'k':
+            chunk_count = parse_size_list(optarg, chunk_sizes, MAX_CHUNK_SIZES);
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        default:
+            printf("Usage: %s [-t fifo,socketpair,unix,mqueue,shm] [-s min_payload] [-S max_payload] [-k chunk,...] [-o file.csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc || min_payload == 0 || max_payload < min_payload || chunk_count <= 0)
+    {
+        printf("Usage: %s [-t fifo,socketpair,unix,mqueue,shm] [-s min_payload] [-S max_payload] [-k chunk,...] [-o file.csv]\n", argv[0]);
+        printf("Sizes accept K, M and G suffixes.\n");
+        return 1;
+    }
+
+    int selected[TRANSPORT_COUNT];
+    for (int i = 0; i < TRANSPORT_COUNT; i++)
+        selected[i] = transport_list == NULL;
+    for (char *name = transport_list != NULL ? strtok(transport_list, ",") : NULL; name != NULL; name = strtok(NULL, ","))
+    {
+        int found = 0;
+        for (int i = 0; i < TRANSPORT_COUNT; i++)
+            if (strcmp(name, transports[i].name) == 0)
+                selected[i] = found = 1;
+        if (!found)
+        {
+            printf("Invalid transport '%s'. Use 'fifo', 'socketpair', 'unix', 'mqueue' or 'shm'.\n", name);
+            return 1;
+        }
+    }
+
+    // A receiver that dies mid-case must fail that case with EPIPE, not kill the whole sweep
+    signal(SIGPIPE, SIG_IGN);
+
+    FILE *out = stdout;
+    if (output_path != NULL && (out = fopen(output_path, "w")) == NULL)
+    {
+        perror("Failed to open output file");
+        return 1;
+    }
+
+    //--- Sweep: payloads grow 4x per step, every selected transport and chunk size -------
+    fprintf(out, "transport,payload_bytes,chunk_bytes,messages,wall_ms,throughput_mib_s,amortized_us_per_message,"
+                 "latency_p50_us,latency_p99_us,sender_cpu_ms,receiver_cpu_ms\n");
+    fflush(out);
+    int failures = 0;
+    for (uint64_t payload = min_payload; payload <= max_payload; payload *= 4)
+    {
+        for (int t = 0; t < TRANSPORT_COUNT; t++)
+        {
+            if (!selected[t])
+                continue;
+            for (int k = 0; k < chunk_count; k++)
+            {
+                if (chunk_sizes[k] > payload && k > 0)
+                    continue; // same as a smaller chunk
+                if (run_case(&transports[t], payload, chunk_sizes[k] < payload ? chunk_sizes[k] : payload, out) == -1)
+                    failures++;
+            }
+        }
+        if (payload > max_payload / 4)
+            break;
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return failures > 0;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+// Moves payload bytes from the parent to a forked receiver and appends one CSV row; returns 0,
+// 1 if the transport cannot be set up with this chunk size (e.g. mqueue limits) or -1 on failure.
+// The sender cycles over a chunk-sized buffer so multi-gigabyte payloads need no large allocation.
+// Every message of at least 8 bytes starts with its send time; the receiver reassembles message
+// boundaries and keeps send-to-arrival latencies, which include queueing behind earlier messages.
+int run_case(const transport_ops_t *ops, uint64_t payload, size_t chunk, FILE *out)
+{
+    channel_t channel;
+    memset(&channel, 0, sizeof(channel));
+    channel.fd = -1; // no descriptor until attach succeeds
+    channel.chunk = chunk;
+    if (ops->prepare(&channel) == -1)
+    {
+        fprintf(stderr, "%s: chunk %zu skipped: %s\n", ops->name, chunk, strerror(errno));
+        return 1;
+    }
+    char *buffer = (char *)malloc(chunk);
+    if (buffer == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < chunk; i++)
+        buffer[i] = (char)i;
+    latency_report_t *report = (latency_report_t *)mmap(NULL, sizeof(latency_report_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (report == MAP_FAILED)
+    {
+        perror("Failed to map latency report");
+        exit(EXIT_FAILURE);
+    }
+    report->samples = 0;
+
+    struct rusage self_start, self_end, children_start, children_end;
+    getrusage(RUSAGE_CHILDREN, &children_start);
+    fflush(out);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("Failed to fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        //--- Receiver -----------------------------------------------------------------
+        uint64_t received = 0, samples = 0;
+        uint64_t *latencies = (uint64_t *)malloc((payload / chunk + 1) * sizeof(uint64_t));
+        if (latencies == NULL || ops->attach(&channel, SIDE_RECEIVER) == -1)
+            _exit(EXIT_FAILURE);
+        while (received < payload)
+        {
+            // Streams may split or merge writes, so read exactly one message's bytes
+            size_t length = payload - received < chunk ? (size_t)(payload - received) : chunk;
+            for (size_t got = 0; got < length;)
+            {
+                ssize_t bytes = ops->recv(&channel, buffer + got, length - got);
+                if (bytes <= 0)
+                    _exit(EXIT_FAILURE);
+                got += bytes;
+            }
+            if (length >= sizeof(uint64_t))
+            {
+                uint64_t sent_ns;
+                memcpy(&sent_ns, buffer, sizeof(sent_ns));
+                latencies[samples++] = monotonic_ns() - sent_ns;
+            }
+            received += length;
+        }
+        ops->detach(&channel, SIDE_RECEIVER);
+        if (samples > 0)
+        {
+            qsort(latencies, samples, sizeof(uint64_t), compare_u64);
+            report->p50_us = latencies[(samples - 1) * 50 / 100] / 1e3;
+            report->p99_us = latencies[(samples - 1) * 99 / 100] / 1e3;
+            report->samples = samples;
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    //--- Sender -------------------------------------------------------------------------
+    int status = 0;
+    uint64_t messages = 0;
+    int attached = ops->attach(&channel, SIDE_SENDER) == 0;
+    if (!attached)
+        status = -1;
+    struct timespec start, end;
+    getrusage(RUSAGE_SELF, &self_start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t sent = 0; status == 0 && sent < payload; messages++)
+    {
+        size_t length = payload - sent < chunk ? (size_t)(payload - sent) : chunk;
+        if (length >= sizeof(uint64_t))
+        {
+            uint64_t sent_ns = monotonic_ns();
+            memcpy(buffer, &sent_ns, sizeof(sent_ns));
+        }
+        if (ops->send(&channel, buffer, length) == -1)
+            status = -1;
+        sent += length;
+    }
+    // Only a successful attach leaves something to release; without one the receiver may still
+    // be waiting in its own attach
+    if (attached)
+        ops->detach(&channel, SIDE_SENDER);
+    else
+        kill(pid, SIGKILL);
+
+    int child_status;
+    while (waitpid(pid, &child_status, 0) == -1 && errno == EINTR)
+        ;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &self_end);
+    getrusage(RUSAGE_CHILDREN, &children_end);
+    ops->cleanup(&channel);
+    free(buffer);
+    latency_report_t latency = *report;
+    munmap(report, sizeof(latency_report_t));
+
+    if (status == -1 || !WIFEXITED(child_status) || WEXITSTATUS(child_status) != 0)
+    {
+        fprintf(stderr, "%s: payload %llu chunk %zu failed\n", ops->name, (unsigned long long)payload, chunk);
+        return -1;
+    }
+
+    double wall_ms = timespec_diff_ms(&start, &end);
+    fprintf(out, "%s,%llu,%zu,%llu,%.3f,%.1f,%.3f,", ops->name, (unsigned long long)payload, chunk,
+            (unsigned long long)messages, wall_ms, payload / (1024.0 * 1024.0) / (wall_ms / 1e3), wall_ms * 1e3 / messages);
+    if (latency.samples > 0)
+        fprintf(out, "%.3f,%.3f,", latency.p50_us, latency.p99_us);
+    else
+        fprintf(out, ",,"); // chunks below 8 bytes carry no stamp
+    fprintf(out, "%.3f,%.3f\n", rusage_cpu_ms(&self_end) - rusage_cpu_ms(&self_start), rusage_cpu_ms(&children_end) - rusage_cpu_ms(&children_start));
+    fflush(out);
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+// Accepts plain byte counts or K/M/G suffixes (powers of 1024)
+uint64_t parse_size(const char *text)
+{
+    char *end;
+    uint64_t value = strtoull(text, &end, 10);
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        value <<= 10;
+        /* fall through */
+    case 'M':
+    case 'm':
+        value <<= 10;
+        /* fall through */
+    case 'K':
+    case 'k':
+        value <<= 10;
+        break;
+    }
+    return value;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+int parse_size_list(char *list, size_t *sizes, int max)
+{
+    int count = 0;
+    for (char *item = strtok(list, ","); item != NULL && count < max; item = strtok(NULL, ","))
+    {
+        sizes[count] = (size_t)parse_size(item);
+        if (sizes[count] == 0)
+            return -1;
+        count++;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+uint64_t monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
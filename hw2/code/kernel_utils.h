@@ -0,0 +1,883 @@
+#ifndef _KERNEL_UTILS_H
+#define _KERNEL_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86 1
+#endif
+
+//=== Widening sums ==============================================================================
+
+typedef int64_t (*sum_i32_fn)(const int32_t *values, size_t count);
+typedef __int128 (*sum_i64_fn)(const int64_t *values, size_t count);
+
+int64_t sum_i32_scalar(const int32_t *values, size_t count)
+{
+    int64_t acc[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        acc[0] += values[i];
+        acc[1] += values[i + 1];
+        acc[2] += values[i + 2];
+        acc[3] += values[i + 3];
+    }
+    for (; i < count; i++)
+        acc[0] += values[i];
+    return acc[0] + acc[1] + acc[2] + acc[3];
+}
+
+__int128 sum_i64_scalar(const int64_t *values, size_t count)
+{
+    __int128 acc = 0;
+    for (size_t i = 0; i < count; i++)
+        acc += values[i];
+    return acc;
+}
+
+#ifdef KERNELS_X86
+__attribute__((target("sse4.1"))) int64_t sum_i32_sse41(const int32_t *values, size_t count)
+{
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        acc0 = _mm_add_epi64(acc0, _mm_cvtepi32_epi64(v));
+        acc1 = _mm_add_epi64(acc1, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    int64_t sum = lanes[0] + lanes[1];
+    for (; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+
+__attribute__((target("avx2"))) int64_t sum_i32_avx2(const int32_t *values, size_t count)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+        acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+    int64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+
+// Each lane keeps a 128-bit accumulator as (hi, lo). Carries out of lo are detected with a
+// signed compare on sign-flipped values, since AVX2 has no unsigned 64-bit compare.
+__attribute__((target("avx2"))) __int128 sum_i64_avx2(const int64_t *values, size_t count)
+{
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = zero;
+    __m256i hi = zero;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i next = _mm256_add_epi64(lo, v);
+        __m256i carry = _mm256_cmpgt_epi64(_mm256_xor_si256(lo, flip), _mm256_xor_si256(next, flip));
+        hi = _mm256_sub_epi64(hi, carry);
+        hi = _mm256_add_epi64(hi, _mm256_cmpgt_epi64(zero, v));
+        lo = next;
+    }
+    uint64_t lo_lanes[4];
+    int64_t hi_lanes[4];
+    _mm256_storeu_si256((__m256i *)lo_lanes, lo);
+    _mm256_storeu_si256((__m256i *)hi_lanes, hi);
+    __int128 sum = 0;
+    for (int lane = 0; lane < 4; lane++)
+        sum += (__int128)(((unsigned __int128)(uint64_t)hi_lanes[lane] << 64) | lo_lanes[lane]);
+    for (; i < count; i++)
+        sum += values[i];
+    return sum;
+}
+#endif
+
+sum_i32_fn sum_i32 = sum_i32_scalar;
+sum_i64_fn sum_i64 = sum_i64_scalar;
+const char *sum_kernel_name = "scalar";
+
+// Picks the widest kernels the running CPU supports; call once before the first reduction
+void init_kernels()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        sum_i32 = sum_i32_avx2;
+        sum_i64 = sum_i64_avx2;
+        sum_kernel_name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse4.1"))
+    {
+        sum_i32 = sum_i32_sse41;
+        sum_kernel_name = "sse4.1";
+    }
+#endif
+}
+
+//=== Products ===================================================================================
+
+typedef enum
+{
+    PRODUCT_WRAP, // modulo 2^64, what the original long long loop computed
+    PRODUCT_MOD,  // modulo a user supplied prime
+    PRODUCT_EXACT // arbitrary precision through a product tree
+} product_mode_t;
+
+// Four independent chains so the multiplier latency overlaps
+uint64_t product_wrap_i32(const int32_t *values, size_t count)
+{
+    uint64_t acc[4] = {1, 1, 1, 1};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        acc[0] *= (uint64_t)(int64_t)values[i];
+        acc[1] *= (uint64_t)(int64_t)values[i + 1];
+        acc[2] *= (uint64_t)(int64_t)values[i + 2];
+        acc[3] *= (uint64_t)(int64_t)values[i + 3];
+    }
+    for (; i < count; i++)
+        acc[0] *= (uint64_t)(int64_t)values[i];
+    return acc[0] * acc[1] * acc[2] * acc[3];
+}
+
+uint64_t mulmod(uint64_t a, uint64_t b, uint64_t modulus)
+{
+    return (uint64_t)((unsigned __int128)a * b % modulus);
+}
+
+// Unsigned throughout: a modulus of 2^63 or more does not fit an int64
+uint64_t reduce_mod(int64_t value, uint64_t modulus)
+{
+    if (value >= 0)
+        return (uint64_t)value % modulus;
+    uint64_t r = (0 - (uint64_t)value) % modulus; // magnitude, exact even for INT64_MIN
+    return r == 0 ? 0 : modulus - r;
+}
+
+uint64_t product_mod_i32(const int32_t *values, size_t count, uint64_t modulus)
+{
+    uint64_t acc[4] = {1 % modulus, 1 % modulus, 1 % modulus, 1 % modulus};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        acc[0] = mulmod(acc[0], reduce_mod(values[i], modulus), modulus);
+        acc[1] = mulmod(acc[1], reduce_mod(values[i + 1], modulus), modulus);
+        acc[2] = mulmod(acc[2], reduce_mod(values[i + 2], modulus), modulus);
+        acc[3] = mulmod(acc[3], reduce_mod(values[i + 3], modulus), modulus);
+    }
+    for (; i < count; i++)
+        acc[0] = mulmod(acc[0], reduce_mod(values[i], modulus), modulus);
+    return mulmod(mulmod(acc[0], acc[1], modulus), mulmod(acc[2], acc[3], modulus), modulus);
+}
+
+uint64_t product_wrap_i64(const int64_t *values, size_t count)
+{
+    uint64_t acc[4] = {1, 1, 1, 1};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        acc[0] *= (uint64_t)values[i];
+        acc[1] *= (uint64_t)values[i + 1];
+        acc[2] *= (uint64_t)values[i + 2];
+        acc[3] *= (uint64_t)values[i + 3];
+    }
+    for (; i < count; i++)
+        acc[0] *= (uint64_t)values[i];
+    return acc[0] * acc[1] * acc[2] * acc[3];
+}
+
+uint64_t product_mod_i64(const int64_t *values, size_t count, uint64_t modulus)
+{
+    uint64_t acc = 1 % modulus;
+    for (size_t i = 0; i < count; i++)
+        acc = mulmod(acc, reduce_mod(values[i], modulus), modulus);
+    return acc;
+}
+
+static uint64_t powmod(uint64_t base, uint64_t exponent, uint64_t modulus)
+{
+    uint64_t result = 1 % modulus;
+    base %= modulus;
+    for (; exponent > 0; exponent >>= 1)
+    {
+        if (exponent & 1)
+            result = mulmod(result, base, modulus);
+        base = mulmod(base, base, modulus);
+    }
+    return result;
+}
+
+// Miller-Rabin with the first twelve prime bases, which is deterministic for every n < 2^64
+int is_prime_u64(uint64_t n)
+{
+    static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+    if (n < 2)
+        return 0;
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++)
+    {
+        if (n == bases[i])
+            return 1;
+        if (n % bases[i] == 0)
+            return 0;
+    }
+
+    uint64_t d = n - 1;
+    int shifts = 0;
+    while ((d & 1) == 0)
+    {
+        d >>= 1;
+        shifts++;
+    }
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++)
+    {
+        uint64_t x = powmod(bases[i], d, n);
+        if (x == 1 || x == n - 1)
+            continue;
+        int witness = 1;
+        for (int r = 1; r < shifts && witness; r++)
+        {
+            x = mulmod(x, x, n);
+            if (x == n - 1)
+                witness = 0;
+        }
+        if (witness)
+            return 0;
+    }
+    return 1;
+}
+
+//=== Exact products =============================================================================
+
+#define KARATSUBA_THRESHOLD 32
+
+// Magnitude in little-endian 32-bit limbs; used == 0 means zero
+typedef struct
+{
+    uint32_t *limbs;
+    size_t used;
+} bignum_t;
+
+bignum_t bignum_from_u64(uint64_t value)
+{
+    bignum_t number;
+    number.limbs = (uint32_t *)malloc(2 * sizeof(uint32_t));
+    if (number.limbs == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    number.limbs[0] = (uint32_t)value;
+    number.limbs[1] = (uint32_t)(value >> 32);
+    number.used = number.limbs[1] ? 2 : (number.limbs[0] ? 1 : 0);
+    return number;
+}
+
+void bignum_free(bignum_t *number)
+{
+    free(number->limbs);
+    number->limbs = NULL;
+    number->used = 0;
+}
+
+size_t trim_limbs(const uint32_t *limbs, size_t used)
+{
+    while (used > 0 && limbs[used - 1] == 0)
+        used--;
+    return used;
+}
+
+// out[0 .. an + bn) = a * b, out must not alias the inputs
+void mul_schoolbook(uint32_t *out, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    memset(out, 0, (an + bn) * sizeof(uint32_t));
+    for (size_t i = 0; i < an; i++)
+    {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < bn; j++)
+        {
+            uint64_t t = (uint64_t)a[i] * b[j] + out[i + j] + carry;
+            out[i + j] = (uint32_t)t;
+            carry = t >> 32;
+        }
+        out[i + bn] = (uint32_t)carry;
+    }
+}
+
+// out += in, returns the carry out of the last limb of out
+uint32_t add_limbs(uint32_t *out, size_t out_n, const uint32_t *in, size_t in_n)
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < in_n; i++)
+    {
+        uint64_t t = (uint64_t)out[i] + in[i] + carry;
+        out[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    for (; carry && i < out_n; i++)
+    {
+        uint64_t t = (uint64_t)out[i] + carry;
+        out[i] = (uint32_t)t;
+        carry = t >> 32;
+    }
+    return (uint32_t)carry;
+}
+
+// out -= in, out must be at least as large as in
+void sub_limbs(uint32_t *out, size_t out_n, const uint32_t *in, size_t in_n)
+{
+    int64_t borrow = 0;
+    size_t i = 0;
+    for (; i < in_n; i++)
+    {
+        int64_t t = (int64_t)out[i] - in[i] - borrow;
+        borrow = t < 0;
+        out[i] = (uint32_t)t;
+    }
+    for (; borrow && i < out_n; i++)
+    {
+        int64_t t = (int64_t)out[i] - borrow;
+        borrow = t < 0;
+        out[i] = (uint32_t)t;
+    }
+}
+
+// Balanced operands of n limbs each; out receives 2n limbs
+void mul_karatsuba(uint32_t *out, const uint32_t *a, const uint32_t *b, size_t n)
+{
+    if (n < KARATSUBA_THRESHOLD)
+    {
+        mul_schoolbook(out, a, n, b, n);
+        return;
+    }
+    size_t low = n / 2;
+    size_t high = n - low;
+
+    uint32_t *sa = (uint32_t *)calloc(high + 1, sizeof(uint32_t));
+    uint32_t *sb = (uint32_t *)calloc(high + 1, sizeof(uint32_t));
+    uint32_t *mid = (uint32_t *)calloc(2 * (high + 1), sizeof(uint32_t));
+    if (sa == NULL || sb == NULL || mid == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // z0 = a_lo * b_lo, z2 = a_hi * b_hi, mid = (a_lo + a_hi)(b_lo + b_hi) - z0 - z2
+    memset(out, 0, 2 * n * sizeof(uint32_t));
+    mul_karatsuba(out, a, b, low);
+    mul_karatsuba(out + 2 * low, a + low, b + low, high);
+
+    memcpy(sa, a + low, high * sizeof(uint32_t));
+    add_limbs(sa, high + 1, a, low);
+    memcpy(sb, b + low, high * sizeof(uint32_t));
+    add_limbs(sb, high + 1, b, low);
+    mul_karatsuba(mid, sa, sb, high + 1);
+    sub_limbs(mid, 2 * (high + 1), out, 2 * low);
+    sub_limbs(mid, 2 * (high + 1), out + 2 * low, 2 * high);
+    add_limbs(out + low, 2 * n - low, mid, trim_limbs(mid, 2 * (high + 1)));
+
+    free(sa);
+    free(sb);
+    free(mid);
+}
+
+bignum_t bignum_mul(const bignum_t *a, const bignum_t *b)
+{
+    bignum_t product;
+    size_t n = a->used + b->used;
+    product.limbs = (uint32_t *)calloc(n > 0 ? n : 1, sizeof(uint32_t));
+    if (product.limbs == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (a->used == 0 || b->used == 0)
+    {
+        product.used = 0;
+        return product;
+    }
+
+    const bignum_t *small = a->used <= b->used ? a : b;
+    const bignum_t *large = a->used <= b->used ? b : a;
+    if (small->used < KARATSUBA_THRESHOLD)
+        mul_schoolbook(product.limbs, large->limbs, large->used, small->limbs, small->used);
+    else
+    {
+        // Split the larger operand into blocks the size of the smaller one and run Karatsuba per block
+        size_t block = small->used;
+        uint32_t *scratch = (uint32_t *)calloc(2 * block, sizeof(uint32_t));
+        uint32_t *padded = (uint32_t *)calloc(block, sizeof(uint32_t));
+        if (scratch == NULL || padded == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t offset = 0; offset < large->used; offset += block)
+        {
+            size_t take = large->used - offset < block ? large->used - offset : block;
+            memset(padded, 0, block * sizeof(uint32_t));
+            memcpy(padded, large->limbs + offset, take * sizeof(uint32_t));
+            mul_karatsuba(scratch, padded, small->limbs, block);
+            add_limbs(product.limbs + offset, n - offset, scratch, trim_limbs(scratch, 2 * block));
+        }
+        free(scratch);
+        free(padded);
+    }
+    product.used = trim_limbs(product.limbs, n);
+    return product;
+}
+
+void bignum_add_u64(bignum_t *number, uint64_t value)
+{
+    uint32_t *limbs = (uint32_t *)realloc(number->limbs, (number->used + 3) * sizeof(uint32_t));
+    if (limbs == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    number->limbs = limbs;
+    memset(limbs + number->used, 0, 3 * sizeof(uint32_t));
+    uint32_t addend[2] = {(uint32_t)value, (uint32_t)(value >> 32)};
+    add_limbs(limbs, number->used + 3, addend, 2);
+    number->used = trim_limbs(limbs, number->used + 3);
+}
+
+int compare_limbs(const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+    an = trim_limbs(a, an);
+    bn = trim_limbs(b, bn);
+    if (an != bn)
+        return an < bn ? -1 : 1;
+    for (size_t i = an; i-- > 0;)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+// Signed addition on a magnitude plus sign flag: (number, *negative) += value
+void bignum_add_i128(bignum_t *number, int *negative, __int128 value)
+{
+    if (value == 0)
+        return;
+    int value_negative = value < 0;
+    unsigned __int128 magnitude = value_negative ? -(unsigned __int128)value : (unsigned __int128)value;
+    uint32_t addend[4];
+    for (int i = 0; i < 4; i++)
+        addend[i] = (uint32_t)(magnitude >> (32 * i));
+
+    size_t size = (number->used > 4 ? number->used : 4) + 1;
+    uint32_t *limbs = (uint32_t *)realloc(number->limbs, size * sizeof(uint32_t));
+    if (limbs == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(limbs + number->used, 0, (size - number->used) * sizeof(uint32_t));
+    number->limbs = limbs;
+
+    if (number->used == 0 || *negative == value_negative)
+    {
+        add_limbs(limbs, size, addend, 4);
+        *negative = value_negative;
+    }
+    else if (compare_limbs(limbs, number->used, addend, 4) >= 0)
+        sub_limbs(limbs, size, addend, 4);
+    else
+    {
+        // |value| > |number|: result is |value| - |number| with the sign of value
+        uint32_t difference[4];
+        memcpy(difference, addend, sizeof(difference));
+        sub_limbs(difference, 4, limbs, number->used);
+        memset(limbs, 0, size * sizeof(uint32_t));
+        memcpy(limbs, difference, sizeof(difference));
+        *negative = value_negative;
+    }
+    number->used = trim_limbs(limbs, size);
+    if (number->used == 0)
+        *negative = 0;
+}
+
+size_t bignum_bits(const bignum_t *number)
+{
+    if (number->used == 0)
+        return 0;
+    return (number->used - 1) * 32 + (32 - __builtin_clz(number->limbs[number->used - 1]));
+}
+
+// Decimal rendering is quadratic, so callers should check bignum_bits for huge values first
+char *bignum_to_string(const bignum_t *number, int negative)
+{
+    size_t used = number->used;
+    size_t max_digits = used * 10 + 2;
+    char *text = (char *)malloc(max_digits + 1);
+    uint32_t *work = (uint32_t *)malloc((used > 0 ? used : 1) * sizeof(uint32_t));
+    if (text == NULL || work == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(work, number->limbs, used * sizeof(uint32_t));
+
+    size_t pos = max_digits;
+    text[pos] = '\0';
+    while (used > 0)
+    {
+        uint64_t remainder = 0;
+        for (size_t i = used; i-- > 0;)
+        {
+            uint64_t cur = (remainder << 32) | work[i];
+            work[i] = (uint32_t)(cur / 1000000000u);
+            remainder = cur % 1000000000u;
+        }
+        used = trim_limbs(work, used);
+        for (int d = 0; d < 9 && (used > 0 || remainder > 0); d++)
+        {
+            text[--pos] = (char)('0' + remainder % 10);
+            remainder /= 10;
+        }
+    }
+    if (pos == max_digits)
+        text[--pos] = '0';
+    if (negative && !(pos == max_digits - 1 && text[pos] == '0'))
+        text[--pos] = '-';
+    memmove(text, text + pos, max_digits - pos + 1);
+    free(work);
+    return text;
+}
+
+// Incremental product tree: levels[k] holds the product of 2^k leaves, merged like a binary
+// counter so operands stay balanced no matter how the values arrive.
+#define PRODUCT_TREE_LEVELS 64
+
+typedef struct
+{
+    bignum_t levels[PRODUCT_TREE_LEVELS];
+    int occupied[PRODUCT_TREE_LEVELS];
+    int negative;
+    int zero;
+} product_tree_t;
+
+void product_tree_init(product_tree_t *tree)
+{
+    memset(tree, 0, sizeof(*tree));
+}
+
+void product_tree_push(product_tree_t *tree, bignum_t leaf)
+{
+    int level = 0;
+    while (level < PRODUCT_TREE_LEVELS - 1 && tree->occupied[level])
+    {
+        bignum_t merged = bignum_mul(&tree->levels[level], &leaf);
+        bignum_free(&tree->levels[level]);
+        bignum_free(&leaf);
+        tree->occupied[level] = 0;
+        leaf = merged;
+        level++;
+    }
+    tree->levels[level] = leaf;
+    tree->occupied[level] = 1;
+}
+
+// Values are packed into 64-bit leaves while the partial product still fits
+void product_tree_fold_i32(product_tree_t *tree, const int32_t *values, size_t count)
+{
+    uint64_t leaf = 1;
+    for (size_t i = 0; i < count && !tree->zero; i++)
+    {
+        int64_t value = values[i];
+        if (value == 0)
+        {
+            tree->zero = 1;
+            break;
+        }
+        if (value < 0)
+        {
+            tree->negative ^= 1;
+            value = -value;
+        }
+        if (leaf > UINT64_MAX / (uint64_t)value)
+        {
+            product_tree_push(tree, bignum_from_u64(leaf));
+            leaf = 1;
+        }
+        leaf *= (uint64_t)value;
+    }
+    if (!tree->zero && leaf != 1)
+        product_tree_push(tree, bignum_from_u64(leaf));
+}
+
+void product_tree_fold_i64(product_tree_t *tree, const int64_t *values, size_t count)
+{
+    uint64_t leaf = 1;
+    for (size_t i = 0; i < count && !tree->zero; i++)
+    {
+        if (values[i] == 0)
+        {
+            tree->zero = 1;
+            break;
+        }
+        // Magnitude computed unsigned so INT64_MIN does not overflow
+        uint64_t magnitude = values[i] < 0 ? 0 - (uint64_t)values[i] : (uint64_t)values[i];
+        if (values[i] < 0)
+            tree->negative ^= 1;
+        if (leaf > UINT64_MAX / magnitude)
+        {
+            product_tree_push(tree, bignum_from_u64(leaf));
+            leaf = 1;
+        }
+        leaf *= magnitude;
+    }
+    if (!tree->zero && leaf != 1)
+        product_tree_push(tree, bignum_from_u64(leaf));
+}
+
+bignum_t product_tree_finish(product_tree_t *tree)
+{
+    bignum_t result = bignum_from_u64(tree->zero ? 0 : 1);
+    for (int level = 0; level < PRODUCT_TREE_LEVELS; level++)
+    {
+        if (!tree->occupied[level])
+            continue;
+        if (!tree->zero)
+        {
+            bignum_t merged = bignum_mul(&result, &tree->levels[level]);
+            bignum_free(&result);
+            result = merged;
+        }
+        bignum_free(&tree->levels[level]);
+        tree->occupied[level] = 0;
+    }
+    return result;
+}
+
+char *int128_to_string(__int128 value, char *buffer, size_t size)
+{
+    char digits[48];
+    int pos = sizeof(digits);
+    unsigned __int128 magnitude = value < 0 ? -(unsigned __int128)value : (unsigned __int128)value;
+    digits[--pos] = '\0';
+    do
+    {
+        digits[--pos] = (char)('0' + (int)(magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0)
+        digits[--pos] = '-';
+    snprintf(buffer, size, "%s", digits + pos);
+    return buffer;
+}
+
+
+//=== Product state shared by the children and the benchmark =====================================
+
+// Values above this many bits are reported by size only, decimal rendering would dominate the run
+#define EXACT_PRINT_MAX_BITS 65536
+
+typedef struct
+{
+    product_mode_t mode;
+    uint64_t modulus;
+    uint64_t value;      // PRODUCT_WRAP and PRODUCT_MOD
+    product_tree_t tree; // PRODUCT_EXACT while folding
+    bignum_t exact;      // PRODUCT_EXACT after product_state_finish
+    int negative;
+} product_state_t;
+
+void product_state_init(product_state_t *state, product_mode_t mode, uint64_t modulus)
+{
+    memset(state, 0, sizeof(*state));
+    state->mode = mode;
+    state->modulus = modulus;
+    state->value = mode == PRODUCT_MOD ? 1 % modulus : 1;
+    product_tree_init(&state->tree);
+}
+
+void product_state_fold_i32(product_state_t *state, const int32_t *values, size_t count)
+{
+    if (state->mode == PRODUCT_WRAP)
+        state->value *= product_wrap_i32(values, count);
+    else if (state->mode == PRODUCT_MOD)
+        state->value = mulmod(state->value, product_mod_i32(values, count, state->modulus), state->modulus);
+    else
+        product_tree_fold_i32(&state->tree, values, count);
+}
+
+void product_state_fold_i64(product_state_t *state, const int64_t *values, size_t count)
+{
+    if (state->mode == PRODUCT_WRAP)
+        state->value *= product_wrap_i64(values, count);
+    else if (state->mode == PRODUCT_MOD)
+        state->value = mulmod(state->value, product_mod_i64(values, count, state->modulus), state->modulus);
+    else
+        product_tree_fold_i64(&state->tree, values, count);
+}
+
+void product_state_finish(product_state_t *state)
+{
+    if (state->mode != PRODUCT_EXACT)
+        return;
+    state->negative = state->tree.negative && !state->tree.zero;
+    state->exact = product_tree_finish(&state->tree);
+}
+
+char *describe_bignum(const bignum_t *number, int negative)
+{
+    if (bignum_bits(number) <= EXACT_PRINT_MAX_BITS)
+        return bignum_to_string(number, negative);
+    char *text = (char *)malloc(96);
+    if (text == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    snprintf(text, 96, "%s<%zu-bit integer>", negative ? "-" : "", bignum_bits(number));
+    return text;
+}
+
+// Returns a malloc'd rendering of the finished product
+char *product_state_to_string(const product_state_t *state)
+{
+    if (state->mode == PRODUCT_EXACT)
+        return describe_bignum(&state->exact, state->negative);
+    char *text = (char *)malloc(32);
+    if (text == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (state->mode == PRODUCT_WRAP)
+        snprintf(text, 32, "%lld", (long long)state->value);
+    else
+        snprintf(text, 32, "%llu", (unsigned long long)state->value);
+    return text;
+}
+
+// Returns a malloc'd rendering of sum + product in the state's arithmetic
+char *product_state_add_sum(product_state_t *state, __int128 sum)
+{
+    if (state->mode == PRODUCT_EXACT)
+    {
+        bignum_add_i128(&state->exact, &state->negative, sum);
+        return describe_bignum(&state->exact, state->negative);
+    }
+    char *text = (char *)malloc(48);
+    if (text == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (state->mode == PRODUCT_WRAP)
+        snprintf(text, 48, "%lld", (long long)(state->value + (uint64_t)sum));
+    else
+    {
+        __int128 r = sum % (__int128)state->modulus;
+        uint64_t reduced = (uint64_t)(r < 0 ? r + state->modulus : r);
+        snprintf(text, 48, "%llu", (unsigned long long)(((unsigned __int128)reduced + state->value) % state->modulus));
+    }
+    return text;
+}
+
+//=== Throughput benchmark =======================================================================
+
+#define BENCH_MIN_SECONDS 0.2
+#define BENCH_EXACT_MAX_VALUES (1 << 16)
+
+volatile uint64_t kernel_sink;
+
+double kernel_elapsed_s(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void report_throughput(const char *name, size_t bytes, int iterations, double seconds)
+{
+    printf("  %-28s %10.4f GB/s  (%d runs, %.3f ms/run)\n", name,
+           (double)bytes * iterations / seconds / 1e9, iterations, seconds * 1e3 / iterations);
+}
+
+// Repeats body until BENCH_MIN_SECONDS have passed and reports bytes per second
+#define BENCH_LOOP(name, bytes, body)                                                      \
+    do                                                                                     \
+    {                                                                                      \
+        struct timespec bench_start;                                                       \
+        int bench_iterations = 0;                                                          \
+        clock_gettime(CLOCK_MONOTONIC, &bench_start);                                      \
+        do                                                                                 \
+        {                                                                                  \
+            body;                                                                          \
+            bench_iterations++;                                                            \
+        } while (kernel_elapsed_s(&bench_start) < BENCH_MIN_SECONDS);                      \
+        report_throughput(name, bytes, bench_iterations, kernel_elapsed_s(&bench_start)); \
+    } while (0)
+
+void run_kernel_benchmark(const int32_t *values, size_t count, uint64_t modulus)
+{
+    size_t bytes = count * sizeof(int32_t);
+    printf("Kernel throughput over %zu values (dispatch: %s):\n", count, sum_kernel_name);
+
+    BENCH_LOOP("sum i32->i64 scalar", bytes, kernel_sink += sum_i32_scalar(values, count));
+#ifdef KERNELS_X86
+    if (__builtin_cpu_supports("sse4.1"))
+        BENCH_LOOP("sum i32->i64 sse4.1", bytes, kernel_sink += sum_i32_sse41(values, count));
+    if (__builtin_cpu_supports("avx2"))
+        BENCH_LOOP("sum i32->i64 avx2", bytes, kernel_sink += sum_i32_avx2(values, count));
+#endif
+
+    int64_t *wide = (int64_t *)malloc(count * sizeof(int64_t));
+    if (wide != NULL)
+    {
+        for (size_t i = 0; i < count; i++)
+            wide[i] = (int64_t)values[i] << 31;
+        BENCH_LOOP("sum i64->i128 scalar", count * sizeof(int64_t), kernel_sink += (uint64_t)sum_i64_scalar(wide, count));
+#ifdef KERNELS_X86
+        if (__builtin_cpu_supports("avx2"))
+            BENCH_LOOP("sum i64->i128 avx2", count * sizeof(int64_t), kernel_sink += (uint64_t)sum_i64_avx2(wide, count));
+#endif
+        free(wide);
+    }
+
+    BENCH_LOOP("product wrap (mod 2^64)", bytes, kernel_sink += product_wrap_i32(values, count));
+    BENCH_LOOP("product mod p", bytes, kernel_sink += product_mod_i32(values, count, modulus));
+
+    // Exact products grow with the input, so time a bounded prefix with zeros mapped to one
+    size_t exact_count = count < BENCH_EXACT_MAX_VALUES ? count : BENCH_EXACT_MAX_VALUES;
+    int32_t *nonzero = (int32_t *)malloc(exact_count * sizeof(int32_t));
+    if (nonzero != NULL)
+    {
+        for (size_t i = 0; i < exact_count; i++)
+            nonzero[i] = values[i] ? values[i] : 1;
+        BENCH_LOOP("product exact (tree)", exact_count * sizeof(int32_t), {
+            product_tree_t tree;
+            product_tree_init(&tree);
+            product_tree_fold_i32(&tree, nonzero, exact_count);
+            bignum_t result = product_tree_finish(&tree);
+            kernel_sink += result.used;
+            bignum_free(&result);
+        });
+        free(nonzero);
+    }
+}
+
+#endif
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <errno.h>
+
+#include "fifo_utils.h"
+#include "protocol_utils.h"
+
+#define DEFAULT_CLIENTS 200
+#define DEFAULT_REQUESTS 50
+#define DEFAULT_VALUES 1024
+
+// Per-client counters, shared with the parent through an anonymous mapping
+typedef struct
+{
+    uint32_t ok;
+    uint32_t busy;
+    uint32_t failed;
+} client_stats_t;
+
+int clients = DEFAULT_CLIENTS;
+int requests = DEFAULT_REQUESTS;
+int values = DEFAULT_VALUES;
+int op = OP_SUM;
+
+void run_load_client(int start_fd, uint64_t *latencies, client_stats_t *stats);
+uint64_t monotonic_ns();
+int compare_u64(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    //--- Check validity of arguments --------------------------------------------------
+    int opt;
+    while ((opt = getopt(argc, argv, "c:r:n:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            clients = atoi(optarg);
+            break;
+        case 'r':
+            requests = atoi(optarg);
+            break;
+        case 'n':
+            values = atoi(optarg);
+            break;
+        case 'o':
+            op = parse_op(optarg);
+            if (op == -1 || op == OP_SHUTDOWN)
+            {
+                printf("Invalid operation '%s'. Use 'sum', 'product', 'min', 'max', 'histogram' or 'prefix-sum'.\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            printf("Usage: %s [-c clients] [-r requests_per_client] [-n values_per_request] [-o op]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind != argc || clients <= 0 || requests <= 0 || values < 0)
+    {
+        printf("Usage: %s [-c clients] [-r requests_per_client] [-n values_per_request] [-o op]\n", argv[0]);
+        return 1;
+    }
+
+    //--- Shared result arrays ---------------------------------------------------------
+    size_t samples = (size_t)clients * requests;
+    uint64_t *latencies = (uint64_t *)mmap(NULL, samples * sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    client_stats_t *stats = (client_stats_t *)mmap(NULL, clients * sizeof(client_stats_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (latencies == MAP_FAILED || stats == MAP_FAILED)
+    {
+        perror("Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //--- Fork clients; they all start when the start pipe is closed -------------------
+    int start_pipe[2];
+    if (pipe(start_pipe) == -1)
+    {
+        perror("Failed to create pipe");
+        exit(EXIT_FAILURE);
+    }
+    fflush(stdout);
+    int started = 0;
+    for (; started < clients; started++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("Failed to fork");
+            break;
+        }
+        if (pid == 0)
+        {
+            close_fd(start_pipe[1]);
+            run_load_client(start_pipe[0], latencies + (size_t)started * requests, &stats[started]);
+            exit(EXIT_SUCCESS);
+        }
+    }
+    close_fd(start_pipe[0]);
+
+    uint64_t start_ns = monotonic_ns();
+    close_fd(start_pipe[1]);
+    int crashed = 0;
+    for (int i = 0; i < started; i++)
+    {
+        int status;
+        while (wait(&status) == -1 && errno == EINTR)
+            ;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            crashed++;
+    }
+    double wall_s = (monotonic_ns() - start_ns) / 1e9;
+
+    //--- Report -----------------------------------------------------------------------
+    unsigned long ok = 0, busy = 0, failed = 0;
+    size_t count = 0;
+    for (int i = 0; i < started; i++)
+    {
+        ok += stats[i].ok;
+        busy += stats[i].busy;
+        failed += stats[i].failed;
+        // Latencies of successful requests sit at the start of each client's slice
+        memmove(latencies + count, latencies + (size_t)i * requests, stats[i].ok * sizeof(uint64_t));
+        count += stats[i].ok;
+    }
+    qsort(latencies, count, sizeof(uint64_t), compare_u64);
+
+    printf("Load: %d clients x %d %s requests of %d values\n", started, requests, op_names[op], values);
+    printf("  completed %lu, busy %lu, failed %lu, crashed clients %d\n", ok, busy, failed, crashed);
+    printf("  wall %.3f s, throughput %.1f req/s\n", wall_s, ok / wall_s);
+    if (count > 0)
+    {
+        double percentiles[] = {50, 90, 99, 99.9};
+        printf("  latency (us):");
+        for (int i = 0; i < 4; i++)
+            printf(" p%g %.1f", percentiles[i], latencies[(size_t)((count - 1) * percentiles[i] / 100)] / 1e3);
+        printf(" max %.1f\n", latencies[count - 1] / 1e3);
+    }
+
+    munmap(latencies, samples * sizeof(uint64_t));
+    munmap(stats, clients * sizeof(client_stats_t));
+    return failed > 0 || crashed > 0 || started < clients;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+// Closed-loop client: sends a request, waits for its reply, records the round trip
+void run_load_client(int start_fd, uint64_t *latencies, client_stats_t *stats)
+{
+    int server_fd = open(SERVER_FIFO_PATH, O_WRONLY | O_NONBLOCK);
+    if (server_fd == -1)
+    {
+        perror("Failed to open SERVER_FIFO, is the server running");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) & ~O_NONBLOCK);
+
+    char path[CLIENT_FIFO_PATH_SIZE];
+    int keepalive_fd;
+    client_fifo_path(path, sizeof(path), (int)getpid());
+    int client_fd = open_client_fifo(path, &keepalive_fd);
+    if (client_fd == -1)
+        exit(EXIT_FAILURE);
+
+    int32_t *numbers = (int32_t *)malloc((values > 0 ? values : 1) * sizeof(int32_t));
+    if (numbers == NULL)
+    {
+        perror("Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    srand(time(NULL) ^ getpid());
+    for (int i = 0; i < values; i++)
+        numbers[i] = rand() % (values > 0 ? values : 1);
+
+    char token;
+    read_fifo_with_retry(start_fd, &token, 1); // returns 0 once the parent closes the pipe
+    close_fd(start_fd);
+
+    for (int i = 0; i < requests; i++)
+    {
+        reply_header_t reply;
+        void *payload;
+        uint64_t sent_ns = monotonic_ns();
+        if (send_request(server_fd, op, (uint32_t)i, numbers, values) == -1 ||
+            receive_reply(client_fd, &reply, &payload) == -1 || reply.request_id != (uint32_t)i)
+        {
+            stats->failed++;
+            break;
+        }
+        free(payload);
+        if (reply.status == STATUS_OK)
+            latencies[stats->ok++] = monotonic_ns() - sent_ns;
+        else if (reply.status == STATUS_BUSY)
+            stats->busy++;
+        else
+            stats->failed++;
+    }
+
+    free(numbers);
+    close_fd(client_fd);
+    close_fd(keepalive_fd);
+    close_fd(server_fd);
+    remove_fifo(path);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+uint64_t monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
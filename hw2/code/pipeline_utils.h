@@ -0,0 +1,295 @@
+#ifndef _PIPELINE_UTILS_H
+#define _PIPELINE_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <errno.h>
+
+#include "fifo_utils.h"
+#include "fanout_utils.h"
+#include "gen_utils.h"
+#include "timing_utils.h"
+
+#define DEFAULT_PIPELINE_WORKERS 2
+#define DEFAULT_CREDITS 4
+#define MAX_CREDITS 64
+
+// Parent -> worker: a job header followed by count ints on the worker's data pipe
+typedef struct
+{
+    uint32_t job_id;
+    uint32_t reserved;
+    int64_t count;
+} job_message_t;
+
+// Worker -> parent on the shared result pipe; well below PIPE_BUF so writes never interleave
+typedef struct
+{
+    uint32_t job_id;
+    uint32_t worker;
+    partial_t partial;
+} job_result_t;
+
+typedef struct
+{
+    int jobs;
+    int arr_size; // jobs hold between arr_size / 2 and 3 * arr_size / 2 values
+    int workers;
+    int credits; // jobs a worker may have outstanding (queued in its pipe or running)
+    uint64_t seed;
+    int gen_threads;
+    uint64_t modulus;
+    size_t chunk_size;
+} pipeline_config_t;
+
+typedef struct
+{
+    pid_t pid;
+    int data_fd; // non-blocking in the parent
+    int credits;
+    int *numbers; // job being written, NULL when idle
+    job_message_t header;
+    size_t length; // header + payload bytes
+    size_t sent;
+    unsigned long jobs;
+} pipeline_worker_t;
+
+typedef struct
+{
+    int64_t count;
+    struct timespec sent;
+    double latency_ms;
+} job_state_t;
+
+typedef void (*job_result_fn)(const job_result_t *result, const job_state_t *job, void *ctx);
+
+int64_t pipeline_job_size(const pipeline_config_t *config, uint32_t job_id)
+{
+    uint64_t state = config->seed ^ ((uint64_t)job_id << 32);
+    return config->arr_size / 2 + (int64_t)(splitmix64(&state) % ((uint64_t)config->arr_size + 1));
+}
+
+// Workers fold each job chunk by chunk as it arrives and report the partial under its job id
+void pipeline_worker(int id, int data_fd, int result_fd, size_t chunk_size, uint64_t modulus)
+{
+    int *chunk = (int *)malloc(chunk_size);
+    if (chunk == NULL)
+        exit(EXIT_FAILURE);
+    size_t per_chunk = chunk_size / sizeof(int);
+    for (;;)
+    {
+        job_message_t message;
+        ssize_t bytes_read = read_fifo_with_retry(data_fd, &message, sizeof(message));
+        if (bytes_read == 0)
+            break; // no more jobs
+        if (bytes_read != sizeof(message))
+            exit(EXIT_FAILURE);
+
+        fanout_fold_t fold = {{0, modulus != 0 ? 1 % modulus : 1}, modulus};
+        for (int64_t offset = 0; offset < message.count; offset += per_chunk)
+        {
+            size_t values = message.count - offset < (int64_t)per_chunk ? (size_t)(message.count - offset) : per_chunk;
+            if (read_fifo_with_retry(data_fd, chunk, values * sizeof(int)) != (ssize_t)(values * sizeof(int)))
+                exit(EXIT_FAILURE);
+            fold_partial(chunk, values, &fold);
+        }
+
+        job_result_t result = {message.job_id, (uint32_t)id, fold.partial};
+        if (write_fifo_with_retry(result_fd, &result, sizeof(result)) == -1)
+            exit(EXIT_FAILURE);
+    }
+    free(chunk);
+    close_fd(data_fd);
+    close_fd(result_fd);
+    exit(EXIT_SUCCESS);
+}
+
+// Writes as much of the worker's current job as its pipe accepts; returns -1 on error
+int pump_job(pipeline_worker_t *worker)
+{
+    while (worker->numbers != NULL)
+    {
+        const char *base;
+        size_t offset, remaining;
+        if (worker->sent < sizeof(job_message_t))
+        {
+            base = (const char *)&worker->header;
+            offset = worker->sent;
+            remaining = sizeof(job_message_t) - worker->sent;
+        }
+        else
+        {
+            base = (const char *)worker->numbers;
+            offset = worker->sent - sizeof(job_message_t);
+            remaining = worker->length - worker->sent;
+        }
+        ssize_t bytes_written = write(worker->data_fd, base + offset, remaining);
+        if (bytes_written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        worker->sent += bytes_written;
+        if (worker->sent == worker->length)
+        {
+            free(worker->numbers);
+            worker->numbers = NULL;
+        }
+    }
+    return 0;
+}
+
+// Runs config->jobs arrays through a pool of workers with a per-worker credit window. The parent
+// never blocks: job data goes out through non-blocking writes as the pipes drain, new jobs are
+// generated only when a worker has credit, and each result returns one credit. Results arrive
+// in completion order and are matched to their job by id. Returns 0 or -1.
+int run_pipeline(const pipeline_config_t *config, job_result_fn on_result, void *ctx)
+{
+    int workers = config->workers;
+    pipeline_worker_t pool[MAX_WORKERS];
+    job_state_t *jobs = (job_state_t *)calloc(config->jobs, sizeof(job_state_t));
+    if (jobs == NULL)
+    {
+        perror("Memory allocation failed");
+        return -1;
+    }
+
+    int result_pipe[2];
+    if (pipe(result_pipe) == -1)
+    {
+        perror("Failed to create result pipe");
+        free(jobs);
+        return -1;
+    }
+    fflush(stdout);
+    for (int i = 0; i < workers; i++)
+    {
+        int data_pipe[2];
+        if (pipe(data_pipe) == -1)
+        {
+            perror("Failed to create worker pipe");
+            return -1;
+        }
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("Failed to fork worker");
+            return -1;
+        }
+        if (pid == 0)
+        {
+            close_fd(data_pipe[1]);
+            close_fd(result_pipe[0]);
+            for (int j = 0; j < i; j++)
+                close_fd(pool[j].data_fd);
+            pipeline_worker(i, data_pipe[0], result_pipe[1], config->chunk_size, config->modulus);
+        }
+        close_fd(data_pipe[0]);
+        fcntl(data_pipe[1], F_SETFL, fcntl(data_pipe[1], F_GETFL) | O_NONBLOCK);
+        memset(&pool[i], 0, sizeof(pool[i]));
+        pool[i].pid = pid;
+        pool[i].data_fd = data_pipe[1];
+        pool[i].credits = config->credits;
+    }
+    close_fd(result_pipe[1]);
+    int result_fd = result_pipe[0];
+
+    int status = 0;
+    int next_job = 0, completed = 0;
+    struct pollfd fds[1 + MAX_WORKERS];
+    while (status == 0 && completed < config->jobs)
+    {
+        //--- Start new jobs on idle workers that still have credit -------------------------
+        for (int i = 0; i < workers && next_job < config->jobs; i++)
+        {
+            pipeline_worker_t *worker = &pool[i];
+            if (worker->numbers != NULL || worker->credits == 0)
+                continue;
+            int64_t count = pipeline_job_size(config, next_job);
+            worker->numbers = (int *)malloc(count > 0 ? count * sizeof(int) : 1);
+            if (worker->numbers == NULL ||
+                generate_numbers(worker->numbers, count, (uint32_t)config->arr_size, config->seed + next_job, config->gen_threads) == -1)
+            {
+                perror("Failed to create a job");
+                status = -1;
+                break;
+            }
+            worker->header = (job_message_t){(uint32_t)next_job, 0, count};
+            worker->length = sizeof(job_message_t) + count * sizeof(int);
+            worker->sent = 0;
+            worker->credits--;
+            worker->jobs++;
+            jobs[next_job].count = count;
+            clock_gettime(CLOCK_MONOTONIC, &jobs[next_job].sent);
+            next_job++;
+            if (pump_job(worker) == -1)
+                status = -1;
+        }
+        if (status != 0)
+            break;
+
+        //--- Wait for pipe space or results --------------------------------------------------
+        fds[0] = (struct pollfd){result_fd, POLLIN, 0};
+        for (int i = 0; i < workers; i++)
+            fds[1 + i] = (struct pollfd){pool[i].numbers != NULL ? pool[i].data_fd : -1, POLLOUT, 0};
+        if (poll(fds, 1 + workers, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll failed");
+            status = -1;
+            break;
+        }
+        for (int i = 0; i < workers; i++)
+            if ((fds[1 + i].revents & (POLLOUT | POLLERR)) && pump_job(&pool[i]) == -1)
+            {
+                perror("Failed to write a job to a worker");
+                status = -1;
+            }
+        if (fds[0].revents & (POLLIN | POLLHUP))
+        {
+            job_result_t result;
+            ssize_t bytes_read = read_fifo_with_retry(result_fd, &result, sizeof(result));
+            if (bytes_read != sizeof(result) || result.job_id >= (uint32_t)next_job || result.worker >= (uint32_t)workers)
+            {
+                fprintf(stderr, "Pipeline: bad or missing result\n");
+                status = -1;
+                break;
+            }
+            job_state_t *job = &jobs[result.job_id];
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            job->latency_ms = timespec_diff_ms(&job->sent, &now);
+            pool[result.worker].credits++;
+            completed++;
+            on_result(&result, job, ctx);
+        }
+    }
+
+    for (int i = 0; i < workers; i++)
+    {
+        free(pool[i].numbers);
+        close_fd(pool[i].data_fd);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        int worker_status;
+        while (waitpid(pool[i].pid, &worker_status, 0) == -1 && errno == EINTR)
+            ;
+        if (!WIFEXITED(worker_status) || WEXITSTATUS(worker_status) != 0)
+            status = -1;
+    }
+    close_fd(result_fd);
+    free(jobs);
+    return status;
+}
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +10,25 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <signal.h>
-
-volatile sig_atomic_t child_count = 2;
-volatile sig_atomic_t child_finished = 0;
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+
+#include "fifo_utils.h"
+#include "shm_utils.h"
+#include "stream_utils.h"
+#include "timing_utils.h"
+#include "fanout_utils.h"
+#include "kernel_utils.h"
+#include "protocol_utils.h"
+#include "server_utils.h"
+#include "gen_utils.h"
+#include "input_utils.h"
+#include "pipeline_utils.h"
+#include "alloc_utils.h"
+#include "trace_utils.h"
+
+int child_count = 2;
 
 #define SERVER_FIFO_PATH "/tmp/server_fifo"
 #define FIFO1_PATH "/tmp/fifo1"
@@ -20,79 +37,384 @@ volatile sig_atomic_t child_finished = 0;
 #define COMMAND "multiply"
 #define REQUEST "REQUEST_MESSAGE"
 #define REQUEST_SIZE 20
-
-void handle_child1(int arr_size);
-void handle_child2(int arr_size);
-void sigchld_handler(int signo);
-void sigusr1_handler(int signo);
-void create_fifo(const char *fifo_path);
-int open_fifo_with_retry(const char *fifo_path, int flags);
-ssize_t read_fifo_with_retry(int fd, void *buf, size_t count);
-ssize_t write_fifo_with_retry(int fd, const void *buf, size_t count);
-void remove_fifo(const char *fifo_path);
-void close_fd(int fd);
-void print(const char *message);
+#define PROCEEDING_INTERVAL_MS 2000
+#define USAGE "Usage: %s [-t fifo|shm|splice] [-k chunk_bytes] [-n workers | -S] [-m wrap|exact|mod] [-p prime] [-B]\n" \
+              "          [-r seed] [-g threads] [-o all|none|summary|sample|bin:path] [-H none|thp|hugetlb] [-P] [-N]\n" \
+              "          [-x trace.json] [-c op [-j jobs]] <array_size>\n" \
+              "       %s [-n workers | -S] [-m wrap|exact|mod] [-p prime] -f input_file [-e 32|64]\n" \
+              "       %s [-n workers] [-m wrap|mod] [-p prime] [-k chunk_bytes] [-r seed] -J jobs [-C credits] <array_size>\n" \
+              "       %s -s [-w workers]\n" \
+              "       %s -c shutdown\n"
+
+typedef enum
+{
+    TRANSPORT_FIFO,
+    TRANSPORT_SHM,
+    TRANSPORT_SPLICE
+} transport_t;
+
+transport_t transport = TRANSPORT_FIFO;
+shm_descriptor_t shm_descriptor;
+size_t chunk_size = DEFAULT_CHUNK_SIZE;
+int fanout_workers = 0;
+int scaling_report = 0;
+product_mode_t product_mode = PRODUCT_WRAP;
+uint64_t product_modulus = 1000000007ULL;
+int kernel_benchmark = 0;
+int server_mode = 0;
+int server_workers = DEFAULT_SERVER_WORKERS;
+int client_op = 0;
+int client_jobs = 1;
+uint64_t seed = 0;
+int seed_given = 0;
+int gen_threads = 0;
+output_mode_t output_mode = OUTPUT_ALL;
+const char *output_path = NULL;
+const char *input_path = NULL;
+int element_size = sizeof(int32_t);
+input_descriptor_t input_descriptor;
+int pipeline_jobs = 0;
+int pipeline_credits = DEFAULT_CREDITS;
+alloc_policy_t alloc_policy = {HUGEPAGE_NONE, 0, 0};
+buffer_t numbers_buffer;
+const char *trace_path = NULL;
+
+int *create_numbers(int arr_size);
+void release_numbers(int *numbers, int arr_size);
+int run_client(const int *numbers, int arr_size);
+void print_reply(const reply_header_t *reply, const void *payload);
+int run_fanout_mode(int *numbers, int64_t count);
+int run_pipeline_mode(int arr_size);
+void print_job_result(const job_result_t *result, const job_state_t *job, void *ctx);
+void print_fanout_result(const partial_t *result);
+int64_t consume_numbers(int fd, int64_t count, chunk_fold_fn fold, fold_i64_fn fold64, void *ctx);
+void fold_sum(const int *values, size_t count, void *ctx);
+void fold_sum_i64(const int64_t *values, size_t count, void *ctx);
+void fold_mult(const int *values, size_t count, void *ctx);
+void fold_mult_i64(const int64_t *values, size_t count, void *ctx);
+void handle_child1(int64_t count);
+void handle_child2(int64_t count);
+int setup_signalfd(sigset_t *old_mask);
+int wait_for_signal(int signal_fd, int timeout_ms);
+void reap_children();
 
 int main(int argc, char *argv[])
 {
     //--- Check validity of arguments --------------------------------------------------
-    if (argc != 2)
+    int opt;
+    while ((opt = getopt(argc, argv, "t:k:n:Sm:p:Bsw:c:j:r:g:o:f:e:J:C:H:PNx:")) != -1)
     {
-        printf("Usage: %s <array_size>\n", argv[0]);
-        return 1;
+        switch (opt)
+        {
+        case 't':
+            if (strcmp(optarg, "fifo") == 0)
+                transport = TRANSPORT_FIFO;
+            else if (strcmp(optarg, "shm") == 0)
+                transport = TRANSPORT_SHM;
+            else if (strcmp(optarg, "splice") == 0)
+                transport = TRANSPORT_SPLICE;
+            else
+            {
+                printf("Invalid transport '%s'. Use 'fifo', 'shm' or 'splice'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k':
+            chunk_size = normalize_chunk_size(atol(optarg));
+            break;
+        case 'n':
+            fanout_workers = atoi(optarg);
+            if (fanout_workers <= 0 || fanout_workers > MAX_WORKERS)
+            {
+                printf("Invalid number of workers. Please enter a value between 1 and %d.\n", MAX_WORKERS);
+                return 1;
+            }
+            break;
+        case 'S':
+            scaling_report = 1;
+            break;
+        case 'm':
+            if (strcmp(optarg, "wrap") == 0)
+                product_mode = PRODUCT_WRAP;
+            else if (strcmp(optarg, "exact") == 0)
+                product_mode = PRODUCT_EXACT;
+            else if (strcmp(optarg, "mod") == 0)
+                product_mode = PRODUCT_MOD;
+            else
+            {
+                printf("Invalid product mode '%s'. Use 'wrap', 'exact' or 'mod'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            product_modulus = strtoull(optarg, NULL, 10);
+            if (!is_prime_u64(product_modulus))
+            {
+                printf("Invalid modulus '%s'. Please enter a prime.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'B':
+            kernel_benchmark = 1;
+            break;
+        case 's':
+            server_mode = 1;
+            break;
+        case 'w':
+            server_workers = atoi(optarg);
+            if (server_workers <= 0 || server_workers > MAX_SERVER_WORKERS)
+            {
+                printf("Invalid number of server workers. Please enter a value between 1 and %d.\n", MAX_SERVER_WORKERS);
+                return 1;
+            }
+            break;
+        case 'c':
+            client_op = parse_op(optarg);
+            if (client_op == -1)
+            {
+                printf("Invalid operation '%s'. Use 'sum', 'product', 'min', 'max', 'histogram', 'prefix-sum' or 'shutdown'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r':
+            seed = strtoull(optarg, NULL, 0);
+            seed_given = 1;
+            break;
+        case 'g':
+            gen_threads = atoi(optarg);
+            if (gen_threads <= 0 || gen_threads > MAX_GEN_THREADS)
+            {
+                printf("Invalid number of generator threads. Please enter a value between 1 and %d.\n", MAX_GEN_THREADS);
+                return 1;
+            }
+            break;
+        case 'o':
+            if (strcmp(optarg, "all") == 0)
+                output_mode = OUTPUT_ALL;
+            else if (strcmp(optarg, "none") == 0)
+                output_mode = OUTPUT_NONE;
+            else if (strcmp(optarg, "summary") == 0)
+                output_mode = OUTPUT_SUMMARY;
+            else if (strcmp(optarg, "sample") == 0)
+                output_mode = OUTPUT_SAMPLE;
+            else if (strncmp(optarg, "bin:", 4) == 0 && optarg[4] != '\0')
+            {
+                output_mode = OUTPUT_BINARY;
+                output_path = optarg + 4;
+            }
+            else
+            {
+                printf("Invalid output mode '%s'. Use 'all', 'none', 'summary', 'sample' or 'bin:<path>'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            input_path = optarg;
+            break;
+        case 'e':
+            if (strcmp(optarg, "32") == 0)
+                element_size = sizeof(int32_t);
+            else if (strcmp(optarg, "64") == 0)
+                element_size = sizeof(int64_t);
+            else
+            {
+                printf("Invalid element width '%s'. Use '32' or '64'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'H':
+            if (parse_hugepage_mode(optarg) == -1)
+            {
+                printf("Invalid huge page mode '%s'. Use 'none', 'thp' or 'hugetlb'.\n", optarg);
+                return 1;
+            }
+            alloc_policy.hugepages = (hugepage_mode_t)parse_hugepage_mode(optarg);
+            break;
+        case 'x':
+            trace_path = optarg;
+            break;
+        case 'P':
+            alloc_policy.populate = 1;
+            break;
+        case 'N':
+            alloc_policy.interleave = 1;
+            break;
+        case 'J':
+            pipeline_jobs = atoi(optarg);
+            if (pipeline_jobs <= 0)
+            {
+                printf("Invalid number of pipeline jobs. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        case 'C':
+            pipeline_credits = atoi(optarg);
+            if (pipeline_credits <= 0 || pipeline_credits > MAX_CREDITS)
+            {
+                printf("Invalid number of credits. Please enter a value between 1 and %d.\n", MAX_CREDITS);
+                return 1;
+            }
+            break;
+        case 'j':
+            client_jobs = atoi(optarg);
+            if (client_jobs <= 0)
+            {
+                printf("Invalid number of jobs. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        default:
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (server_mode || client_op == OP_SHUTDOWN)
+    {
+        if (argc - optind != 0)
+        {
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        init_kernels();
+        if (server_mode)
+            return run_compute_server(server_workers);
+        return run_client(NULL, 0);
+    }
+    int arr_size = 0;
+    int64_t data_count;
+    if (input_path != NULL)
+    {
+        //--- File input: the readers map the dataset themselves ---------------------------
+        if (argc - optind != 0 || kernel_benchmark || client_op != 0 || pipeline_jobs > 0)
+        {
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        if (open_input_file(input_path, element_size, &input_descriptor) == -1)
+        {
+            perror("Failed to open input file");
+            return 1;
+        }
+        data_count = input_descriptor.count;
+    }
+    else
+    {
+        if (argc - optind != 1)
+        {
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        arr_size = atoi(argv[optind]);
+        if (arr_size <= 0)
+        {
+            printf("Invalid array size. Please enter a positive integer.\n");
+            return 1;
+        }
+        data_count = arr_size;
     }
-    int arr_size = atoi(argv[1]);
-    if (arr_size <= 0)
+    if ((fanout_workers > 0 || scaling_report || pipeline_jobs > 0) && product_mode == PRODUCT_EXACT)
     {
-        printf("Invalid array size. Please enter a positive integer.\n");
+        printf("Exact products are only available in the two-child mode.\n");
         return 1;
     }
+    init_kernels();
+
+    //--- Pipeline mode: many arrays in flight under credit-based flow control ------------
+    if (pipeline_jobs > 0)
+    {
+        if (scaling_report || kernel_benchmark || client_op != 0)
+        {
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+        return run_pipeline_mode(arr_size);
+    }
+    if (transport == TRANSPORT_SPLICE)
+    {
+        // Whole-page chunks keep every full payload eligible for SPLICE_F_GIFT
+        size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        chunk_size = (chunk_size + page_size - 1) / page_size * page_size;
+    }
+
+    enum
+    {
+        PHASE_SETUP,
+        PHASE_RENDEZVOUS,
+        PHASE_TRANSFER,
+        PHASE_DRAIN,
+        PHASE_COUNT
+    };
+    phase_t phases[PHASE_COUNT];
+    int fanout_mode = fanout_workers > 0 || scaling_report;
+    if (trace_path != NULL && !fanout_mode && !kernel_benchmark && client_op == 0)
+    {
+        // Parent and both children record into one shared region; slot 0 is the parent
+        if (trace_init(1 + child_count) == -1)
+        {
+            perror("Failed to map trace buffers");
+            return 1;
+        }
+        trace_attach(0, "parent");
+    }
+    phase_begin(&phases[PHASE_SETUP], "setup");
+    trace_begin("setup");
 
     //--- Create FIFOs -----------------------------------------------------------------
-    create_fifo(SERVER_FIFO_PATH);
-    printf("Parent process: SERVER_FIFO in '%s' is created!\n", SERVER_FIFO_PATH);
-    create_fifo(FIFO1_PATH);
-    printf("Parent process: FIFO1 in '%s' is created!\n", FIFO1_PATH);
-    create_fifo(FIFO2_PATH);
-    printf("Parent process: FIFO2 in '%s' is created!\n", FIFO2_PATH);
-
-    //--- Create random numbers -------------------------------------------------------
-    int *numbers = (int *)malloc(arr_size * sizeof(int));
-    if (numbers == NULL)
+    if (!fanout_mode && !kernel_benchmark && client_op == 0)
     {
-        perror("Memory allocation failed.\n");
-        exit(EXIT_FAILURE);
+        create_fifo(SERVER_FIFO_PATH);
+        printf("Parent process: SERVER_FIFO in '%s' is created!\n", SERVER_FIFO_PATH);
+        create_fifo(FIFO1_PATH);
+        printf("Parent process: FIFO1 in '%s' is created!\n", FIFO1_PATH);
+        create_fifo(FIFO2_PATH);
+        printf("Parent process: FIFO2 in '%s' is created!\n", FIFO2_PATH);
     }
-    srand(time(NULL));
-    for (int i = 0; i < arr_size; i++)
-        numbers[i] = rand() % arr_size;
 
-    printf("Numbers: ");
-    for (int i = 0; i < arr_size; i++)
-        printf("%d ", numbers[i]);
-    printf("\n");
+    //--- Create random numbers (or describe the input file) -------------------------
+    int *numbers = NULL;
+    if (input_path == NULL)
+        numbers = create_numbers(arr_size);
+    else
+        printf("Parent process: input file '%s' holds %lld int%d values, readers map it directly\n", input_path,
+               (long long)data_count, element_size * 8);
+
+    trace_end("setup");
+    phase_end(&phases[PHASE_SETUP]);
 
-    //--- Set signal handlers --------------------------------------------------------------
-    // Signal handler for SIGCHLD
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = sigchld_handler;
-    if (sigaction(SIGCHLD, &sa, NULL) == -1)
+    //--- Client mode: send the array to the persistent server ----------------------------
+    if (client_op != 0)
     {
-        perror("Failed to set SIGCHLD handler");
-        exit(EXIT_FAILURE);
+        int status = run_client(numbers, arr_size);
+        release_numbers(numbers, arr_size);
+        return status;
     }
-    // Signal handler for SIGUSR1
-    struct sigaction sa2;
-    memset(&sa2, 0, sizeof(sa2));
-    sa2.sa_handler = sigusr1_handler;
-    if (sigaction(SIGUSR1, &sa2, NULL) == -1)
+
+    //--- Kernel benchmark: measure reduction throughput on the generated array -----------
+    if (kernel_benchmark)
     {
-        perror("Failed to set SIGUSR1 handler");
-        exit(EXIT_FAILURE);
+        fflush(stdout);
+        run_kernel_benchmark(numbers, arr_size, product_modulus);
+        release_numbers(numbers, arr_size);
+        return 0;
+    }
+
+    //--- Fan-out mode: N workers with a tree reduction instead of the two-child protocol --
+    if (fanout_mode)
+    {
+        int status = run_fanout_mode(numbers, data_count);
+        release_numbers(numbers, arr_size);
+        return status;
     }
 
+    //--- Route SIGCHLD and SIGUSR1 through a signalfd ------------------------------------
+    sigset_t old_mask;
+    int signal_fd = setup_signalfd(&old_mask);
+
     //--- Create child processes -----------------------------------------------------------
+    phase_begin(&phases[PHASE_RENDEZVOUS], "rendezvous");
+    trace_begin("rendezvous");
+    trace_begin("fork");
+    fflush(stdout);
     for (int i = 0; i < 2; i++)
     {
         int pid = fork();
@@ -103,78 +425,145 @@ int main(int argc, char *argv[])
         }
         else if (pid == 0)
         {
-            sleep(10);
+            trace_attach(1 + i, i == 0 ? "child 1 (sum)" : "child 2 (multiply)");
+            trace_instant("forked");
+            close_fd(signal_fd);
+            if (sigprocmask(SIG_SETMASK, &old_mask, NULL) == -1)
+            {
+                perror("Failed to restore signal mask");
+                exit(EXIT_FAILURE);
+            }
             if (kill(getppid(), SIGUSR1) == -1)
             {
                 perror("Failed to send signal with kill");
                 exit(EXIT_FAILURE);
             }
             if (i == 0)
-                handle_child1(arr_size);
+                handle_child1(data_count);
             else
-                handle_child2(arr_size);
+                handle_child2(data_count);
             exit(EXIT_SUCCESS);
         }
     }
 
-    //--- Display proceeding message ---------------------------------------------------------
-    while (!child_finished)
+    trace_end("fork");
+
+    //--- Display proceeding message until a child is ready --------------------------------
+    trace_begin("wait for SIGUSR1");
+    print("Parent process: Proceeding...\n");
+    int signo;
+    while ((signo = wait_for_signal(signal_fd, PROCEEDING_INTERVAL_MS)) != SIGUSR1)
     {
-        print("Parent process: Proceeding...\n");
-        sleep(2);
+        if (signo == 0)
+            print("Parent process: Proceeding...\n");
+        else if (signo == SIGCHLD)
+        {
+            reap_children();
+            if (child_count == 0)
+            {
+                fprintf(stderr, "Child processes exited before the transfer started\n");
+                release_numbers(numbers, arr_size);
+                exit(EXIT_FAILURE);
+            }
+        }
     }
+    trace_end("wait for SIGUSR1");
+    trace_end("rendezvous");
+    phase_end(&phases[PHASE_RENDEZVOUS]);
+    phase_begin(&phases[PHASE_TRANSFER], "transfer");
+    trace_begin("transfer");
 
     //--- Open SERVER_FIFO to read a request from Child 1 ----------------------------------
     char request[REQUEST_SIZE];
+    trace_begin("open SERVER_FIFO");
     int server_fifo_fd = open_fifo_with_retry(SERVER_FIFO_PATH, O_RDONLY);
+    trace_end("open SERVER_FIFO");
     if (server_fifo_fd == -1)
     {
         perror("Failed to open SERVER_FIFO for reading");
         close(server_fifo_fd);
-        free(numbers);
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
 
     //--- Read request from Child 1 --------------------------------------------------------
+    trace_begin("read request");
     if (read_fifo_with_retry(server_fifo_fd, &request, strlen(REQUEST)) == -1)
     {
         perror("Failed to read from SERVER_FIFO");
         close_fd(server_fifo_fd);
-        free(numbers);
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
+    trace_end("read request");
 
     //--- Open FIFO1 to write --------------------------------------------------------------
+    trace_begin("open FIFO1");
     int fifo1_fd = open_fifo_with_retry(FIFO1_PATH, O_WRONLY);
+    trace_end("open FIFO1");
     if (fifo1_fd == -1)
     {
         perror("Failed to open FIFO1 for writing");
         close_fd(server_fifo_fd);
         close_fd(fifo1_fd);
-        free(numbers);
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
 
-    //--- Write array to FIFO1 -------------------------------------------------------------
-    if (write_fifo_with_retry(fifo1_fd, numbers, arr_size * sizeof(int)) == -1)
+    //--- Write array (or its shared memory / input file descriptor) to FIFO1 ------------
+    trace_begin("write FIFO1");
+    if (input_path != NULL)
     {
-        perror("Failed to write numbers to FIFO1");
-        close_fd(server_fifo_fd);
-        close_fd(fifo1_fd);
-        free(numbers);
-        exit(EXIT_FAILURE);
+        if (write_fifo_with_retry(fifo1_fd, &input_descriptor, sizeof(input_descriptor)) == -1)
+        {
+            perror("Failed to write input file descriptor to FIFO1");
+            close_fd(server_fifo_fd);
+            close_fd(fifo1_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        print("Parent process: input file descriptor is written to FIFO1\n");
     }
-    print("Parent process: numbers array are written to FIFO1\n");
+    else if (transport == TRANSPORT_SHM)
+    {
+        if (write_fifo_with_retry(fifo1_fd, &shm_descriptor, sizeof(shm_descriptor)) == -1)
+        {
+            perror("Failed to write shared memory descriptor to FIFO1");
+            close_fd(server_fifo_fd);
+            close_fd(fifo1_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        print("Parent process: shared memory descriptor is written to FIFO1\n");
+    }
+    else
+    {
+        if (stream_numbers(fifo1_fd, numbers, arr_size, chunk_size, transport == TRANSPORT_SPLICE) == -1)
+        {
+            perror("Failed to write numbers to FIFO1");
+            close_fd(server_fifo_fd);
+            close_fd(fifo1_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        if (transport == TRANSPORT_SPLICE && !vmsplice_unsupported)
+            print("Parent process: numbers array are spliced into FIFO1\n");
+        else
+            print("Parent process: numbers array are written to FIFO1\n");
+    }
+    trace_end("write FIFO1");
     close_fd(server_fifo_fd);
 
     //--- Open FIFO2 to write --------------------------------------------------------------
+    trace_begin("open FIFO2");
     int fifo2_fd = open_fifo_with_retry(FIFO2_PATH, O_WRONLY);
+    trace_end("open FIFO2");
     if (fifo2_fd == -1)
     {
         perror("Failed to open FIFO2 for writing");
         close_fd(fifo1_fd);
         close_fd(fifo2_fd);
-        free(numbers);
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
 
@@ -184,33 +573,87 @@ int main(int argc, char *argv[])
         perror("Failed to write command to FIFO2");
         close_fd(fifo1_fd);
         close_fd(fifo2_fd);
-        free(numbers);
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
     print("Parent process: 'multiply' command is written to FIFO2\n");
 
-    //--- Write array to FIFO2 -------------------------------------------------------------
-    if (write_fifo_with_retry(fifo2_fd, numbers, arr_size * sizeof(int)) == -1)
+    //--- Write array (or its shared memory / input file descriptor) to FIFO2 ------------
+    trace_begin("write FIFO2");
+    if (input_path != NULL)
     {
-        perror("Failed to write numbers to FIFO2");
-        close_fd(fifo1_fd);
-        close_fd(fifo2_fd);
-        free(numbers);
-        exit(EXIT_FAILURE);
+        if (write_fifo_with_retry(fifo2_fd, &input_descriptor, sizeof(input_descriptor)) == -1)
+        {
+            perror("Failed to write input file descriptor to FIFO2");
+            close_fd(fifo1_fd);
+            close_fd(fifo2_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        print("Parent process: input file descriptor is written to FIFO2\n");
+    }
+    else if (transport == TRANSPORT_SHM)
+    {
+        if (write_fifo_with_retry(fifo2_fd, &shm_descriptor, sizeof(shm_descriptor)) == -1)
+        {
+            perror("Failed to write shared memory descriptor to FIFO2");
+            close_fd(fifo1_fd);
+            close_fd(fifo2_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        print("Parent process: shared memory descriptor is written to FIFO2\n");
     }
-    print("Parent process: numbers array are written to FIFO2\n");
+    else
+    {
+        if (stream_numbers(fifo2_fd, numbers, arr_size, chunk_size, transport == TRANSPORT_SPLICE) == -1)
+        {
+            perror("Failed to write numbers to FIFO2");
+            close_fd(fifo1_fd);
+            close_fd(fifo2_fd);
+            release_numbers(numbers, arr_size);
+            exit(EXIT_FAILURE);
+        }
+        if (transport == TRANSPORT_SPLICE && !vmsplice_unsupported)
+            print("Parent process: numbers array are spliced into FIFO2\n");
+        else
+            print("Parent process: numbers array are written to FIFO2\n");
+    }
+
+    trace_end("write FIFO2");
+    trace_end("transfer");
+    phase_end(&phases[PHASE_TRANSFER]);
 
+    //--- Wait for children to exit --------------------------------------------------------
+    phase_begin(&phases[PHASE_DRAIN], "drain");
+    trace_begin("drain");
     while (child_count > 0)
-        ;
+    {
+        if (wait_for_signal(signal_fd, -1) == SIGCHLD)
+            reap_children();
+    }
+    trace_end("drain");
+    phase_end(&phases[PHASE_DRAIN]);
 
     // Free resources
-    free(numbers);
+    release_numbers(numbers, arr_size);
     close_fd(fifo1_fd);
     close_fd(fifo2_fd);
     remove_fifo(SERVER_FIFO_PATH);
     remove_fifo(FIFO1_PATH);
     remove_fifo(FIFO2_PATH);
+    close_fd(signal_fd);
 
+    print_phase_report(phases, PHASE_COUNT);
+    if (trace_path != NULL)
+    {
+        // The children have been reaped, so their buffers are complete
+        if (trace_write_json(trace_path) == -1)
+            perror("Failed to write trace");
+        else
+            printf("Parent process: trace written to '%s'\n", trace_path);
+        trace_release();
+    }
     print("Parent process: Terminating...\n");
     return 0;
 }
@@ -218,72 +661,505 @@ int main(int argc, char *argv[])
 //------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------
 
-void handle_child1(int arr_size)
+// Allocates the array for the selected transport, fills it and reports it per output_mode
+int *create_numbers(int arr_size)
 {
-    int sum = 0;
-    int fifo1_fd, fifo2_fd, server_fifo_fd;
-    char request[REQUEST_SIZE];
-    int *numbers = (int *)malloc(arr_size * sizeof(int));
-    if (numbers == NULL)
+    int *numbers;
+    if (transport == TRANSPORT_SHM)
+    {
+        // Numbers are generated directly into the shared region, children read them in place
+        snprintf(shm_descriptor.shm_name, SHM_NAME_SIZE, "%s_%d", SHM_NUMBERS_PREFIX, (int)getpid());
+        shm_descriptor.arr_size = arr_size;
+        numbers = create_shm_array(shm_descriptor.shm_name, arr_size);
+        advise_buffer(numbers, arr_size * sizeof(int), &alloc_policy);
+        printf("Parent process: shared memory '%s' is created!\n", shm_descriptor.shm_name);
+    }
+    else
+    {
+        // Anonymous mappings are page-aligned, so splice mode can vmsplice the chunks as they are
+        if (alloc_buffer(&numbers_buffer, arr_size * sizeof(int), &alloc_policy) == -1)
+        {
+            perror("Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
+        }
+        numbers = (int *)numbers_buffer.base;
+        alloc_policy.hugepages = numbers_buffer.hugepages; // hugetlb may have fallen back to THP
+    }
+    if (alloc_policy.hugepages != HUGEPAGE_NONE || alloc_policy.populate || alloc_policy.interleave)
+        printf("Parent process: numbers use %s huge pages%s%s\n", hugepage_names[alloc_policy.hugepages],
+               alloc_policy.populate ? ", pre-faulted" : "", alloc_policy.interleave ? ", interleaved over NUMA nodes" : "");
+    if (!seed_given)
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    if (gen_threads == 0)
+    {
+        long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+        gen_threads = nproc < 1 ? 1 : nproc > MAX_GEN_THREADS ? MAX_GEN_THREADS : (int)nproc;
+    }
+    struct timespec gen_start, gen_end;
+    clock_gettime(CLOCK_MONOTONIC, &gen_start);
+    if (generate_numbers(numbers, arr_size, (uint32_t)arr_size, seed, gen_threads) == -1)
     {
-        perror("Memory allocation failed");
+        perror("Failed to generate numbers");
+        release_numbers(numbers, arr_size);
         exit(EXIT_FAILURE);
     }
+    clock_gettime(CLOCK_MONOTONIC, &gen_end);
+    if (output_mode != OUTPUT_ALL)
+    {
+        double gen_ms = timespec_diff_ms(&gen_start, &gen_end);
+        printf("Generated %d numbers with seed %llu on %d threads in %.3f ms (%.1f M/s)\n", arr_size,
+               (unsigned long long)seed, gen_threads, gen_ms, arr_size / (gen_ms * 1e3));
+    }
+    if (output_numbers(output_mode, numbers, arr_size, output_path) == -1)
+    {
+        perror("Failed to output numbers");
+        release_numbers(numbers, arr_size);
+        exit(EXIT_FAILURE);
+    }
+    return numbers;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void release_numbers(int *numbers, int arr_size)
+{
+    if (numbers == NULL)
+        return;
+    if (transport == TRANSPORT_SHM)
+    {
+        detach_shm_array(numbers, arr_size);
+        remove_shm_array(shm_descriptor.shm_name);
+    }
+    else
+        free_buffer(&numbers_buffer);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+// Sends client_jobs requests of the whole array to the compute server one after another
+int run_client(const int *numbers, int arr_size)
+{
+    char buffer[256];
+    int server_fd = open(SERVER_FIFO_PATH, O_WRONLY | O_NONBLOCK);
+    if (server_fd == -1)
+    {
+        perror("Failed to open SERVER_FIFO, is the server running");
+        return 1;
+    }
+    fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL) & ~O_NONBLOCK);
+
+    if (client_op == OP_SHUTDOWN)
+    {
+        int status = send_request(server_fd, OP_SHUTDOWN, 0, NULL, 0);
+        close_fd(server_fd);
+        print(status == 0 ? "Client: shutdown requested\n" : "Client: failed to request shutdown\n");
+        return status == 0 ? 0 : 1;
+    }
+
+    char path[CLIENT_FIFO_PATH_SIZE];
+    int keepalive_fd;
+    client_fifo_path(path, sizeof(path), (int)getpid());
+    int client_fd = open_client_fifo(path, &keepalive_fd);
+    if (client_fd == -1)
+    {
+        close_fd(server_fd);
+        return 1;
+    }
+
+    fflush(stdout);
+    int status = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int job = 0; job < client_jobs; job++)
+    {
+        reply_header_t reply;
+        void *payload;
+        if (send_request(server_fd, client_op, (uint32_t)job, (const int32_t *)numbers, arr_size) == -1 ||
+            receive_reply(client_fd, &reply, &payload) == -1)
+        {
+            perror("Client: request failed");
+            status = 1;
+            break;
+        }
+        if (reply.request_id != (uint32_t)job || reply.status != STATUS_OK || job == 0)
+            print_reply(&reply, payload);
+        free(payload);
+        if (reply.status != STATUS_OK)
+        {
+            status = 1;
+            break;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (status == 0)
+    {
+        double wall_ms = timespec_diff_ms(&start, &end);
+        snprintf(buffer, sizeof(buffer), "Client: %d %s jobs in %.3f ms (%.1f jobs/s, %.3f ms per job)\n", client_jobs,
+                 op_names[client_op], wall_ms, client_jobs * 1000.0 / wall_ms, wall_ms / client_jobs);
+        print(buffer);
+    }
+    close_fd(client_fd);
+    close_fd(keepalive_fd);
+    close_fd(server_fd);
+    remove_fifo(path);
+    return status;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void print_reply(const reply_header_t *reply, const void *payload)
+{
+    const char *status_names[] = {"ok", "bad request", "empty input", "busy"};
+    char buffer[256];
+    if (reply->status != STATUS_OK)
+    {
+        snprintf(buffer, sizeof(buffer), "Client: request %u failed: %s\n", reply->request_id,
+                 reply->status >= 0 && reply->status <= STATUS_BUSY ? status_names[reply->status] : "unknown status");
+        print(buffer);
+        return;
+    }
+
+    switch (reply->op)
+    {
+    case OP_SUM:
+    case OP_MIN:
+    case OP_MAX:
+        snprintf(buffer, sizeof(buffer), "Client: %s = %lld\n", op_names[reply->op], (long long)*(const int64_t *)payload);
+        print(buffer);
+        break;
+    case OP_PRODUCT:
+        snprintf(buffer, sizeof(buffer), "Client: product = %lld\n", (long long)*(const uint64_t *)payload);
+        print(buffer);
+        break;
+    case OP_HISTOGRAM:
+    {
+        const histogram_reply_t *histogram = (const histogram_reply_t *)payload;
+        snprintf(buffer, sizeof(buffer), "Client: histogram of [%d, %d]:", histogram->min, histogram->max);
+        print(buffer);
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            snprintf(buffer, sizeof(buffer), " %llu", (unsigned long long)histogram->counts[i]);
+            print(buffer);
+        }
+        print("\n");
+        break;
+    }
+    case OP_PREFIX_SUM:
+    {
+        size_t count = reply->length / sizeof(int64_t);
+        snprintf(buffer, sizeof(buffer), "Client: prefix sums (%zu values), last = %lld\n", count,
+                 count > 0 ? (long long)((const int64_t *)payload)[count - 1] : 0LL);
+        print(buffer);
+        break;
+    }
+    }
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void print_fanout_result(const partial_t *result)
+{
+    product_state_t state;
+    product_state_init(&state, product_mode, product_modulus);
+    state.value = result->product;
+    char *result_text = product_state_add_sum(&state, result->sum);
+    print("Result: ");
+    print(result_text);
+    print(product_mode == PRODUCT_MOD ? " (mod p)\n" : "\n");
+    free(result_text);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+typedef struct
+{
+    int completed;
+    int out_of_order; // results that overtook a lower job id
+    uint32_t highest_id;
+    int64_t values;
+    double latency_ms;
+} pipeline_stats_t;
+
+void print_job_result(const job_result_t *result, const job_state_t *job, void *ctx)
+{
+    pipeline_stats_t *stats = (pipeline_stats_t *)ctx;
+    if (stats->completed > 0 && result->job_id < stats->highest_id)
+        stats->out_of_order++;
+    if (stats->completed == 0 || result->job_id > stats->highest_id)
+        stats->highest_id = result->job_id;
+    stats->completed++;
+    stats->values += job->count;
+    stats->latency_ms += job->latency_ms;
+
+    char buffer[256], sum_text[48];
+    snprintf(buffer, sizeof(buffer), "Job %u (%lld values, worker %u): sum = %s, multiplication = %llu (%.3f ms)\n",
+             result->job_id, (long long)job->count, result->worker, int128_to_string(result->partial.sum, sum_text, sizeof(sum_text)),
+             (unsigned long long)result->partial.product, job->latency_ms);
+    print(buffer);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+int run_pipeline_mode(int arr_size)
+{
+    if (!seed_given)
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    pipeline_config_t config;
+    config.jobs = pipeline_jobs;
+    config.arr_size = arr_size;
+    config.workers = fanout_workers > 0 ? fanout_workers : DEFAULT_PIPELINE_WORKERS;
+    config.credits = pipeline_credits;
+    config.seed = seed;
+    config.gen_threads = gen_threads > 0 ? gen_threads : 1;
+    config.modulus = product_mode == PRODUCT_MOD ? product_modulus : 0;
+    config.chunk_size = chunk_size;
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "Pipeline: %d jobs of %d..%d values, %d workers x %d credits (seed %llu)\n", config.jobs,
+             arr_size / 2, arr_size / 2 + arr_size, config.workers, config.credits, (unsigned long long)seed);
+    print(buffer);
+
+    pipeline_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (run_pipeline(&config, print_job_result, &stats) == -1)
+        return 1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double wall_ms = timespec_diff_ms(&start, &end);
+    snprintf(buffer, sizeof(buffer), "Pipeline: %d jobs in %.3f ms (%.1f jobs/s, %.1f MiB/s), mean latency %.3f ms, %d out of order\n",
+             stats.completed, wall_ms, stats.completed / (wall_ms / 1e3),
+             stats.values * sizeof(int) / (1024.0 * 1024.0) / (wall_ms / 1e3), stats.latency_ms / stats.completed, stats.out_of_order);
+    print(buffer);
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+int run_fanout_mode(int *numbers, int64_t count)
+{
+    char buffer[256];
+    fanout_job_t job;
+    job.numbers = numbers;
+    job.arr_size = count;
+    job.input = input_path != NULL ? &input_descriptor : NULL;
+    job.shm_name = transport == TRANSPORT_SHM ? shm_descriptor.shm_name : NULL;
+    job.chunk_size = chunk_size;
+    job.modulus = product_mode == PRODUCT_MOD ? product_modulus : 0;
+    job.zero_copy = transport == TRANSPORT_SPLICE;
+    fflush(stdout);
+
+    if (!scaling_report)
+    {
+        partial_t result;
+        struct timespec start, end;
+        job.workers = fanout_workers;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (run_fanout(&job, &result) == -1)
+            return 1;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        char sum_text[48];
+        snprintf(buffer, sizeof(buffer), "Fan-out with %d workers: sum = %s, multiplication = %lld (%.3f ms)\n", job.workers,
+                 int128_to_string(result.sum, sum_text, sizeof(sum_text)), (long long)result.product, timespec_diff_ms(&start, &end));
+        print(buffer);
+        print_fanout_result(&result);
+        return 0;
+    }
+
+    //--- Scaling report: 1, 2, 4, ... workers up to the number of online CPUs -------------
+    long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nproc < 1)
+        nproc = 1;
+    if (nproc > MAX_WORKERS)
+        nproc = MAX_WORKERS;
+
+    double base_ms = 0;
+    partial_t reference;
+    print("Scaling report:\n");
+    snprintf(buffer, sizeof(buffer), "  %8s %12s %10s %12s\n", "workers", "wall (ms)", "speedup", "efficiency");
+    print(buffer);
+    for (long workers = 1;; workers = workers * 2 > nproc && workers < nproc ? nproc : workers * 2)
+    {
+        partial_t result;
+        struct timespec start, end;
+        job.workers = workers;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (run_fanout(&job, &result) == -1)
+            return 1;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double wall_ms = timespec_diff_ms(&start, &end);
+        if (workers == 1)
+        {
+            base_ms = wall_ms;
+            reference = result;
+        }
+        else if (result.sum != reference.sum || result.product != reference.product)
+        {
+            fprintf(stderr, "Fan-out with %ld workers disagrees with the single worker result\n", workers);
+            return 1;
+        }
+        snprintf(buffer, sizeof(buffer), "  %8ld %12.3f %10.2f %11.1f%%\n", workers, wall_ms,
+                 base_ms / wall_ms, 100.0 * base_ms / wall_ms / workers);
+        print(buffer);
+        if (workers >= nproc)
+            break;
+    }
+    print_fanout_result(&reference);
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+// Feeds the array to fold: chunk by chunk as it streams in over a FIFO, or in one pass in shm mode
+int64_t consume_numbers(int fd, int64_t count, chunk_fold_fn fold, fold_i64_fn fold64, void *ctx)
+{
+    if (input_path != NULL)
+    {
+        input_descriptor_t descriptor;
+        if (read_fifo_with_retry(fd, &descriptor, sizeof(descriptor)) != sizeof(descriptor))
+            return -1;
+        if (descriptor.count != count)
+        {
+            errno = EPROTO;
+            return -1;
+        }
+        return fold_input_range(&descriptor, 0, descriptor.count, fold, fold64, ctx);
+    }
+    int arr_size = (int)count;
+    if (transport == TRANSPORT_SHM)
+    {
+        shm_descriptor_t descriptor;
+        if (read_fifo_with_retry(fd, &descriptor, sizeof(descriptor)) != sizeof(descriptor))
+            return -1;
+        if (descriptor.arr_size != arr_size)
+        {
+            errno = EPROTO;
+            return -1;
+        }
+        const int *numbers = attach_shm_array(descriptor.shm_name, arr_size);
+        if (numbers == NULL)
+            return -1;
+        fold(numbers, arr_size, ctx);
+        detach_shm_array(numbers, arr_size);
+        return arr_size;
+    }
+
+    return receive_stream(fd, chunk_size, fold, ctx);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void fold_sum(const int *values, size_t count, void *ctx)
+{
+    *(__int128 *)ctx += sum_i32(values, count);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void fold_sum_i64(const int64_t *values, size_t count, void *ctx)
+{
+    *(__int128 *)ctx += sum_i64(values, count);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void fold_mult(const int *values, size_t count, void *ctx)
+{
+    product_state_fold_i32((product_state_t *)ctx, values, count);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void fold_mult_i64(const int64_t *values, size_t count, void *ctx)
+{
+    product_state_fold_i64((product_state_t *)ctx, values, count);
+}
+
+//------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------
+
+void handle_child1(int64_t count)
+{
+    __int128 sum = 0; // 64-bit inputs can overflow an int64 sum
+    int fifo1_fd, fifo2_fd, server_fifo_fd;
+    char request[REQUEST_SIZE];
 
     //--- Open SERVER_FIFO to write a request ----------------------------------------------
+    trace_begin("open SERVER_FIFO");
     server_fifo_fd = open_fifo_with_retry(SERVER_FIFO_PATH, O_WRONLY);
     if (server_fifo_fd == -1)
     {
         perror("Failed to open SERVER_FIFO for writing");
         close_fd(server_fifo_fd);
-        free(numbers);
         exit(EXIT_FAILURE);
     }
+    trace_end("open SERVER_FIFO");
 
     //--- Write request to SERVER_FIFO -----------------------------------------------------
     if (write_fifo_with_retry(server_fifo_fd, REQUEST, strlen(REQUEST)) == -1)
     {
         perror("Failed to read request from SERVER_FIFO");
         close_fd(server_fifo_fd);
-        free(numbers);
         exit(EXIT_FAILURE);
     }
+    trace_instant("request written");
 
     //--- Open FIFO1 to read ---------------------------------------------------------------
+    trace_begin("open FIFO1");
     fifo1_fd = open_fifo_with_retry(FIFO1_PATH, O_RDONLY);
+    trace_end("open FIFO1");
     if (fifo1_fd == -1)
     {
         perror("Failed to open FIFO1 for writing");
         close_fd(server_fifo_fd);
         close_fd(fifo1_fd);
-        free(numbers);
         exit(EXIT_FAILURE);
     }
 
-    //--- Read array from FIFO1 ------------------------------------------------------------
-    if (read_fifo_with_retry(fifo1_fd, numbers, arr_size * sizeof(int)) == -1)
+    //--- Read array from FIFO1 and sum it as chunks arrive -------------------------------
+    trace_begin("receive + sum");
+    if (consume_numbers(fifo1_fd, count, fold_sum, fold_sum_i64, &sum) != count)
     {
         perror("Failed to read from FIFO1");
         close_fd(server_fifo_fd);
         close_fd(fifo1_fd);
-        free(numbers);
         exit(EXIT_FAILURE);
     }
-    print("Child process 1: numbers are read from FIFO1\n");
+    trace_end("receive + sum");
+    if (input_path != NULL)
+        print("Child process 1: numbers are mapped from the input file\n");
+    else if (transport == TRANSPORT_SHM)
+        print("Child process 1: numbers are mapped from shared memory\n");
+    else
+        print("Child process 1: numbers are read from FIFO1\n");
 
     close_fd(server_fifo_fd);
     close_fd(fifo1_fd);
 
-    for (int i = 0; i < arr_size; i++)
-        sum += numbers[i];
-
     char buffer[256];
-    snprintf(buffer, sizeof(buffer), "Child process 1: Summation result = %d\n", sum);
+    char sum_text[48];
+    int128_to_string(sum, sum_text, sizeof(sum_text));
+    snprintf(buffer, sizeof(buffer), "Child process 1: Summation result = %s\n", sum_text);
     print(buffer);
 
-    free(numbers);
-
     //--- Open SERVER_FIFO to read a request from Child 2 ----------------------------------
+    trace_begin("wait for child 2");
     server_fifo_fd = open_fifo_with_retry(SERVER_FIFO_PATH, O_RDONLY);
     if (server_fifo_fd == -1)
     {
@@ -300,7 +1176,10 @@ void handle_child1(int arr_size)
         exit(EXIT_FAILURE);
     }
 
+    trace_end("wait for child 2");
+
     //--- Open FIFO2 to write --------------------------------------------------------------
+    trace_begin("hand off sum");
     fifo2_fd = open_fifo_with_retry(FIFO2_PATH, O_WRONLY);
     if (fifo2_fd == -1)
     {
@@ -318,7 +1197,8 @@ void handle_child1(int arr_size)
         close_fd(fifo2_fd);
         exit(EXIT_FAILURE);
     }
-    snprintf(buffer, sizeof(buffer), "Child process 1: sum = %d is written to FIFO2\n", sum);
+    trace_end("hand off sum");
+    snprintf(buffer, sizeof(buffer), "Child process 1: sum = %s is written to FIFO2\n", sum_text);
     print(buffer);
 
     close_fd(server_fifo_fd);
@@ -328,13 +1208,15 @@ void handle_child1(int arr_size)
 //------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------
 
-void handle_child2(int arr_size)
+void handle_child2(int64_t count)
 {
     int fifo2_fd, server_fifo_fd;
     char command[10];
-    long long mult = 1;
+    product_state_t mult;
+    product_state_init(&mult, product_mode, product_modulus);
 
     //--- Open FIFO2 to read ---------------------------------------------------------------
+    trace_begin("open FIFO2");
     fifo2_fd = open_fifo_with_retry(FIFO2_PATH, O_RDONLY);
     if (fifo2_fd == -1)
     {
@@ -342,14 +1224,17 @@ void handle_child2(int arr_size)
         close_fd(fifo2_fd);
         exit(EXIT_FAILURE);
     }
+    trace_end("open FIFO2");
 
     //--- Read 'multiply' command from FIFO2 -----------------------------------------------
+    trace_begin("read command");
     if (read_fifo_with_retry(fifo2_fd, command, strlen(COMMAND) + 1) == -1)
     {
         perror("Failed to read from FIFO2");
         close_fd(fifo2_fd);
         exit(EXIT_FAILURE);
     }
+    trace_end("read command");
     command[strlen(COMMAND)] = '\0';
     char buffer[256];
     snprintf(buffer, sizeof(buffer), "Child process 2: command '%s' is read from FIFO2\n", command);
@@ -358,33 +1243,31 @@ void handle_child2(int arr_size)
     //--- Compare 'multiply' command -------------------------------------------------------
     if (strcmp(command, COMMAND) == 0)
     {
-        int *numbers = (int *)malloc(arr_size * sizeof(int));
-        if (numbers == NULL)
-        {
-            perror("Memory allocation failed");
-            close_fd(fifo2_fd);
-            exit(EXIT_FAILURE);
-        }
-
-        //--- Read array from FIFO2 ------------------------------------------------------------
-        if (read_fifo_with_retry(fifo2_fd, numbers, arr_size * sizeof(int)) == -1)
+        //--- Read array from FIFO2 and multiply it as chunks arrive --------------------------
+        trace_begin("receive + multiply");
+        if (consume_numbers(fifo2_fd, count, fold_mult, fold_mult_i64, &mult) != count)
         {
             perror("Failed to read from FIFO2");
             close_fd(fifo2_fd);
-            free(numbers);
             exit(EXIT_FAILURE);
         }
-        print("Child process 2: numbers are read from FIFO2\n");
-
-        for (int i = 0; i < arr_size; i++)
-            mult = mult * numbers[i];
-
-        snprintf(buffer, sizeof(buffer), "Child process 2: Multiplication result = %lld\n", mult);
-        print(buffer);
-
-        free(numbers);
+        if (input_path != NULL)
+            print("Child process 2: numbers are mapped from the input file\n");
+        else if (transport == TRANSPORT_SHM)
+            print("Child process 2: numbers are mapped from shared memory\n");
+        else
+            print("Child process 2: numbers are read from FIFO2\n");
+
+        product_state_finish(&mult);
+        trace_end("receive + multiply");
+        char *mult_text = product_state_to_string(&mult);
+        print("Child process 2: Multiplication result = ");
+        print(mult_text);
+        print(product_mode == PRODUCT_MOD ? " (mod p)\n" : "\n");
+        free(mult_text);
 
         //--- Open SERVER_FIFO to write a request ----------------------------------------------
+        trace_begin("wait for sum");
         server_fifo_fd = open_fifo_with_retry(SERVER_FIFO_PATH, O_WRONLY);
         if (server_fifo_fd == -1)
         {
@@ -401,7 +1284,7 @@ void handle_child2(int arr_size)
             exit(EXIT_FAILURE);
         }
 
-        int prev_sum = 0;
+        __int128 prev_sum = 0;
         //--- Read sum from FIFO2 -------------------------------------------------------------
         if (read_fifo_with_retry(fifo2_fd, &prev_sum, sizeof(prev_sum)) == -1)
         {
@@ -410,13 +1293,21 @@ void handle_child2(int arr_size)
             close_fd(fifo2_fd);
             exit(EXIT_FAILURE);
         }
+        trace_end("wait for sum");
 
-        snprintf(buffer, sizeof(buffer), "Child process 2: sum = %d is read from FIFO2\n", prev_sum);
+        char sum_text[48];
+        snprintf(buffer, sizeof(buffer), "Child process 2: sum = %s is read from FIFO2\n", int128_to_string(prev_sum, sum_text, sizeof(sum_text)));
         print(buffer);
 
-        long long result = (long long)prev_sum + mult;
-        snprintf(buffer, sizeof(buffer), "Result: %lld\n", result);
-        print(buffer);
+        trace_begin("result");
+        char *result_text = product_state_add_sum(&mult, prev_sum);
+        print("Result: ");
+        print(result_text);
+        print(product_mode == PRODUCT_MOD ? " (mod p)\n" : "\n");
+        free(result_text);
+        trace_end("result");
+        if (product_mode == PRODUCT_EXACT)
+            bignum_free(&mult.exact);
 
         close_fd(fifo2_fd);
         close_fd(server_fifo_fd);
@@ -431,143 +1322,79 @@ void handle_child2(int arr_size)
 //------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------
 
-void sigchld_handler(int signo)
+// SIGCHLD and SIGUSR1 are blocked and consumed through the returned signalfd instead of handlers
+int setup_signalfd(sigset_t *old_mask)
 {
-    int status;
-    pid_t pid;
-    char buffer[256];
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, old_mask) == -1)
     {
-        if (WIFEXITED(status))
-            snprintf(buffer, sizeof(buffer), "Child process pid: %d exited with status: %d\n", pid, WEXITSTATUS(status));
-        else if (WIFSIGNALED(status))
-            snprintf(buffer, sizeof(buffer), "Child process pid: %d terminated by signal: %d\n", pid, WTERMSIG(status));
-        print(buffer);
-
-        if (child_count > 0)
-            child_count--;
-
-        if (pid == -1 && errno != ECHILD)
-        {
-            perror("waitpid failed");
-            exit(EXIT_FAILURE);
-        }
+        perror("Failed to block signals");
+        exit(EXIT_FAILURE);
     }
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
-
-void sigusr1_handler(int signo)
-{
-    child_finished = 1;
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
-
-void create_fifo(const char *fifo_path)
-{
-    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
-    if (access(fifo_path, F_OK) == -1)
+    int signal_fd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (signal_fd == -1)
     {
-        if (mkfifo(fifo_path, mode) == -1)
-        {
-            perror("Failed to create FIFO");
-            exit(EXIT_FAILURE);
-        }
+        perror("Failed to create signalfd");
+        exit(EXIT_FAILURE);
     }
+    return signal_fd;
 }
 
 //------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------
 
-int open_fifo_with_retry(const char *fifo_path, int flags)
+// Returns the received signal number, or 0 if timeout_ms passed without one (-1 waits forever)
+int wait_for_signal(int signal_fd, int timeout_ms)
 {
-    int fd;
-    do
+    struct pollfd pfd = {signal_fd, POLLIN, 0};
+    int ready;
+    while ((ready = poll(&pfd, 1, timeout_ms)) == -1 && errno == EINTR)
+        ;
+    if (ready == -1)
     {
-        fd = open(fifo_path, flags);
-        if (fd == -1 && errno != EINTR)
-        {
-            perror("Failed to open FIFO");
-            return -1;
-        }
-    } while (fd == -1);
-    return fd;
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
+        perror("Failed to poll signalfd");
+        exit(EXIT_FAILURE);
+    }
+    if (ready == 0)
+        return 0;
 
-ssize_t read_fifo_with_retry(int fd, void *buf, size_t count)
-{
+    struct signalfd_siginfo info;
     ssize_t bytes_read;
-    do
-    {
-        bytes_read = read(fd, buf, count);
-        if (bytes_read == -1 && errno != EINTR)
-        {
-            perror("Failed to read from FIFO");
-            return -1;
-        }
-    } while (bytes_read == -1);
-    return bytes_read;
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
-
-ssize_t write_fifo_with_retry(int fd, const void *buf, size_t count)
-{
-    ssize_t bytes_written;
-    do
-    {
-        bytes_written = write(fd, buf, count);
-        if (bytes_written == -1 && errno != EINTR)
-        {
-            perror("Failed to write to FIFO");
-            return -1;
-        }
-    } while (bytes_written == -1);
-    return bytes_written;
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
-
-void remove_fifo(const char *fifo_path)
-{
-    if (unlink(fifo_path) == -1)
+    while ((bytes_read = read(signal_fd, &info, sizeof(info))) == -1 && errno == EINTR)
+        ;
+    if (bytes_read != sizeof(info))
     {
-        perror("Failed to remove FIFO");
+        perror("Failed to read from signalfd");
         exit(EXIT_FAILURE);
     }
+    return info.ssi_signo;
 }
 
 //------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------
 
-void close_fd(int fd)
+void reap_children()
 {
-    if (close(fd) == -1)
+    int status;
+    pid_t pid;
+    char buffer[256];
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
     {
-        perror("Failed to close file descriptor");
-        exit(EXIT_FAILURE);
-    }
-}
-
-//------------------------------------------------------------------------------------------------
-//------------------------------------------------------------------------------------------------
+        if (WIFEXITED(status))
+            snprintf(buffer, sizeof(buffer), "Child process pid: %d exited with status: %d\n", pid, WEXITSTATUS(status));
+        else if (WIFSIGNALED(status))
+            snprintf(buffer, sizeof(buffer), "Child process pid: %d terminated by signal: %d\n", pid, WTERMSIG(status));
+        print(buffer);
 
-void print(const char *message)
-{
-    ssize_t bytes_written;
-    while (((bytes_written = write(STDOUT_FILENO, message, strlen(message))) == -1) && errno == EINTR)
-        ;
-    if (bytes_written == -1)
+        if (child_count > 0)
+            child_count--;
+    }
+    if (pid == -1 && errno != ECHILD)
     {
-        perror("Error while writing to stdout.\n");
+        perror("waitpid failed");
         exit(EXIT_FAILURE);
     }
 }
@@ -0,0 +1,285 @@
+#ifndef _PROTOCOL_UTILS_H
+#define _PROTOCOL_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "fifo_utils.h"
+#include "kernel_utils.h"
+
+#ifndef SERVER_FIFO_PATH
+#define SERVER_FIFO_PATH "/tmp/server_fifo"
+#endif
+#define CLIENT_FIFO_TEMPLATE "/tmp/hw2_client.%d"
+#define CLIENT_FIFO_PATH_SIZE 64
+
+#define PROTOCOL_MAGIC 0x48573243u /* "HW2C" */
+#define HISTOGRAM_BUCKETS 16
+
+typedef enum
+{
+    OP_SUM = 1,
+    OP_PRODUCT,
+    OP_MIN,
+    OP_MAX,
+    OP_HISTOGRAM,
+    OP_PREFIX_SUM,
+    OP_SHUTDOWN,
+    OP_COUNT
+} op_code_t;
+
+#define FRAME_FIRST 0x1
+#define FRAME_LAST 0x2
+
+// Request frames are at most PIPE_BUF bytes, so writes from many clients to the server FIFO
+// never interleave. Requests larger than one frame are split and reassembled by client pid.
+typedef struct
+{
+    uint32_t magic;
+    uint8_t op;
+    uint8_t flags;
+    uint16_t length;       // payload bytes in this frame
+    int32_t pid;           // client pid, names the reply FIFO
+    uint32_t request_id;   // echoed in the reply
+    uint64_t total_length; // payload bytes of the whole request
+} request_frame_t;
+
+#define FRAME_PAYLOAD_MAX (PIPE_BUF - sizeof(request_frame_t))
+
+typedef enum
+{
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST,
+    STATUS_EMPTY_INPUT,
+    STATUS_BUSY
+} reply_status_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t request_id;
+    int32_t status;
+    uint32_t op;
+    uint64_t length; // payload bytes following the header
+} reply_header_t;
+
+typedef struct
+{
+    int32_t min;
+    int32_t max;
+    uint64_t counts[HISTOGRAM_BUCKETS];
+} histogram_reply_t;
+
+const char *op_names[OP_COUNT] = {"", "sum", "product", "min", "max", "histogram", "prefix-sum", "shutdown"};
+
+int parse_op(const char *name)
+{
+    for (int op = 1; op < OP_COUNT; op++)
+        if (strcmp(name, op_names[op]) == 0)
+            return op;
+    return -1;
+}
+
+void client_fifo_path(char *path, size_t size, int pid)
+{
+    snprintf(path, size, CLIENT_FIFO_TEMPLATE, pid);
+}
+
+//--- Operations ---------------------------------------------------------------------------------
+
+// Computes op over values into a malloc'd reply payload; returns a reply_status_t
+int compute_request(int op, const int32_t *values, size_t count, void **payload, uint64_t *length)
+{
+    *payload = NULL;
+    *length = 0;
+    if (op <= 0 || op >= OP_COUNT || op == OP_SHUTDOWN)
+        return STATUS_BAD_REQUEST;
+    if (count == 0 && op != OP_SUM && op != OP_PRODUCT && op != OP_PREFIX_SUM)
+        return STATUS_EMPTY_INPUT;
+
+    size_t size = op == OP_PREFIX_SUM ? count * sizeof(int64_t) : op == OP_HISTOGRAM ? sizeof(histogram_reply_t) : sizeof(int64_t);
+    void *out = malloc(size > 0 ? size : 1);
+    if (out == NULL)
+        return STATUS_BUSY;
+
+    switch (op)
+    {
+    case OP_SUM:
+        *(int64_t *)out = sum_i32(values, count);
+        break;
+    case OP_PRODUCT:
+        *(uint64_t *)out = product_wrap_i32(values, count);
+        break;
+    case OP_MIN:
+    case OP_MAX:
+    {
+        int32_t best = values[0];
+        for (size_t i = 1; i < count; i++)
+            if (op == OP_MIN ? values[i] < best : values[i] > best)
+                best = values[i];
+        *(int64_t *)out = best;
+        break;
+    }
+    case OP_HISTOGRAM:
+    {
+        // Equal-width buckets spanning [min, max]
+        histogram_reply_t *histogram = (histogram_reply_t *)out;
+        memset(histogram, 0, sizeof(*histogram));
+        histogram->min = histogram->max = values[0];
+        for (size_t i = 1; i < count; i++)
+        {
+            if (values[i] < histogram->min)
+                histogram->min = values[i];
+            if (values[i] > histogram->max)
+                histogram->max = values[i];
+        }
+        uint64_t span = (uint64_t)((int64_t)histogram->max - histogram->min) + 1;
+        for (size_t i = 0; i < count; i++)
+            histogram->counts[(uint64_t)((int64_t)values[i] - histogram->min) * HISTOGRAM_BUCKETS / span]++;
+        break;
+    }
+    case OP_PREFIX_SUM:
+    {
+        int64_t running = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            running += values[i];
+            ((int64_t *)out)[i] = running;
+        }
+        break;
+    }
+    }
+    *payload = out;
+    *length = size;
+    return STATUS_OK;
+}
+
+//--- Client side --------------------------------------------------------------------------------
+
+// Sends values as one request split into atomic frames; returns 0 or -1
+int send_request(int server_fd, int op, uint32_t request_id, const int32_t *values, size_t count)
+{
+    char frame[PIPE_BUF];
+    request_frame_t *header = (request_frame_t *)frame;
+    const char *payload = (const char *)values;
+    uint64_t total = (uint64_t)count * sizeof(int32_t);
+    uint64_t offset = 0;
+
+    header->magic = PROTOCOL_MAGIC;
+    header->op = (uint8_t)op;
+    header->pid = (int32_t)getpid();
+    header->request_id = request_id;
+    header->total_length = total;
+    do
+    {
+        uint64_t take = total - offset;
+        // Keep frames a whole number of values so the reassembly buffer stays aligned
+        size_t max_take = FRAME_PAYLOAD_MAX - FRAME_PAYLOAD_MAX % sizeof(int32_t);
+        if (take > max_take)
+            take = max_take;
+        header->flags = (offset == 0 ? FRAME_FIRST : 0) | (offset + take == total ? FRAME_LAST : 0);
+        header->length = (uint16_t)take;
+        memcpy(frame + sizeof(*header), payload + offset, take);
+        if (write_fifo_with_retry(server_fd, frame, sizeof(*header) + take) == -1)
+            return -1;
+        offset += take;
+    } while (offset < total);
+    return 0;
+}
+
+// Creates the client FIFO and opens it without waiting for a writer. A second, write-only
+// descriptor is kept so the FIFO never reports EOF between replies.
+int open_client_fifo(const char *path, int *keepalive_fd)
+{
+    if (mkfifo(path, S_IRUSR | S_IWUSR) == -1 && errno != EEXIST)
+    {
+        perror("Failed to create client FIFO");
+        return -1;
+    }
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd == -1)
+    {
+        perror("Failed to open client FIFO");
+        return -1;
+    }
+    *keepalive_fd = open(path, O_WRONLY);
+    if (*keepalive_fd == -1)
+    {
+        perror("Failed to open client FIFO");
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    return fd;
+}
+
+// Reads one reply; *payload is malloc'd and must be freed by the caller
+int receive_reply(int client_fd, reply_header_t *header, void **payload)
+{
+    *payload = NULL;
+    if (read_fifo_with_retry(client_fd, header, sizeof(*header)) != sizeof(*header) || header->magic != PROTOCOL_MAGIC)
+        return -1;
+    if (header->length == 0)
+        return 0;
+    *payload = malloc(header->length);
+    if (*payload == NULL)
+        return -1;
+    if (read_fifo_with_retry(client_fd, *payload, header->length) != (ssize_t)header->length)
+    {
+        free(*payload);
+        *payload = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Writes count bytes to a non-blocking fd, waiting at most timeout_ms each time the pipe is full
+static int write_reply_bytes(int fd, const void *buf, size_t count, int timeout_ms)
+{
+    size_t total = 0;
+    while (total < count)
+    {
+        ssize_t bytes_written = write(fd, (const char *)buf + total, count - total);
+        if (bytes_written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                return -1; // EPIPE: the client closed its FIFO
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            int ready = poll(&pfd, 1, timeout_ms);
+            if (ready == 0 || (ready == -1 && errno != EINTR))
+                return -1; // the client is not reading
+            continue;
+        }
+        total += bytes_written;
+    }
+    return 0;
+}
+
+// Writes a reply to the FIFO of client pid. The FIFO stays non-blocking, so a client that stopped
+// reading costs at most timeout_ms per full pipe (0: drop at once) before the reply is dropped.
+// Headers are smaller than PIPE_BUF, so a header-only reply lands whole or not at all.
+int send_reply(int pid, const reply_header_t *header, const void *payload, int timeout_ms)
+{
+    char path[CLIENT_FIFO_PATH_SIZE];
+    client_fifo_path(path, sizeof(path), pid);
+    int fd = open(path, O_WRONLY | O_NONBLOCK);
+    if (fd == -1)
+        return -1; // ENXIO: client is gone
+    int status = 0;
+    if (write_reply_bytes(fd, header, sizeof(*header), timeout_ms) == -1 ||
+        (header->length > 0 && write_reply_bytes(fd, payload, header->length, timeout_ms) == -1))
+        status = -1;
+    close(fd);
+    return status;
+}
+
+#endif
@@ -0,0 +1,586 @@
+#ifndef _SERVER_UTILS_H
+#define _SERVER_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <time.h>
+
+#include "fifo_utils.h"
+#include "protocol_utils.h"
+
+#define DEFAULT_SERVER_WORKERS 4
+#define MAX_SERVER_WORKERS 64
+#define MAX_PENDING_REQUESTS 1024
+#define MAX_QUEUED_JOBS 256
+#define MAX_REQUEST_BYTES (256u * 1024 * 1024)
+#define SERVER_READ_BUFFER (16 * PIPE_BUF)
+#define REPLY_TIMEOUT_MS 1000  // a worker gives up on a client that stops reading its reply
+#define PENDING_TIMEOUT_MS 5000 // a request with no new frame for this long is dropped
+#define PENDING_SWEEP_MS 1000
+
+// Server -> worker message on the worker's job pipe, followed by `length` payload bytes
+typedef struct
+{
+    int32_t op;
+    int32_t pid;
+    uint32_t request_id;
+    uint32_t reserved;
+    uint64_t length;
+} job_header_t;
+
+// Client state while its frames are still arriving. A request moves from here to the job
+// queue once its last frame is in, then to a worker, which sends the reply.
+typedef struct
+{
+    int pid; // 0: slot is free
+    uint32_t request_id;
+    uint64_t received;
+    uint64_t deadline_ms; // dropped if its next frame has not arrived by then
+    job_header_t *job;    // header followed by the reassembled payload
+} pending_request_t;
+
+typedef struct
+{
+    job_header_t *job;
+    size_t length;
+} queued_job_t;
+
+typedef struct
+{
+    pid_t pid;
+    int job_fd; // non-blocking in the server
+    int busy;   // set from dispatch until the worker reports back on done_fd
+    char *job;  // job being written to the pipe, NULL once fully sent
+    size_t length;
+    size_t sent;
+    unsigned long jobs;
+} server_worker_t;
+
+typedef struct
+{
+    int workers;
+    server_worker_t worker[MAX_SERVER_WORKERS];
+    int done_fd; // workers report their id here when a job is finished
+    pending_request_t pending[MAX_PENDING_REQUESTS];
+    queued_job_t queue[MAX_QUEUED_JOBS];
+    int queue_head;
+    int queue_count;
+    int peak_queue;
+    unsigned long served;
+    unsigned long rejected;
+} compute_server_t;
+
+uint64_t monotonic_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Sent from the event loop, so it never waits: a client whose FIFO is full loses the reply
+// instead of stalling every other client
+void reply_status(int pid, uint32_t request_id, int op, int status)
+{
+    reply_header_t reply = {PROTOCOL_MAGIC, request_id, status, (uint32_t)op, 0};
+    send_reply(pid, &reply, NULL, 0);
+}
+
+// Worker processes live for the whole server run and take one job at a time
+void server_worker(int id, int job_fd, int done_fd)
+{
+    signal(SIGPIPE, SIG_IGN);
+    for (;;)
+    {
+        job_header_t job;
+        ssize_t bytes_read = read_fifo_with_retry(job_fd, &job, sizeof(job));
+        if (bytes_read == 0)
+            break; // server closed the job pipe
+        if (bytes_read != sizeof(job))
+            exit(EXIT_FAILURE);
+
+        char *values = (char *)malloc(job.length > 0 ? job.length : 1);
+        if (values == NULL || read_fifo_with_retry(job_fd, values, job.length) != (ssize_t)job.length)
+            exit(EXIT_FAILURE);
+
+        void *payload;
+        reply_header_t reply = {PROTOCOL_MAGIC, job.request_id, 0, (uint32_t)job.op, 0};
+        reply.status = compute_request(job.op, (const int32_t *)values, job.length / sizeof(int32_t), &payload, &reply.length);
+        send_reply(job.pid, &reply, payload, REPLY_TIMEOUT_MS);
+        free(payload);
+        free(values);
+
+        if (write_fifo_with_retry(done_fd, &id, sizeof(id)) == -1)
+            exit(EXIT_FAILURE);
+    }
+    close_fd(job_fd);
+    close_fd(done_fd);
+    exit(EXIT_SUCCESS);
+}
+
+int start_server_workers(compute_server_t *server, int workers)
+{
+    int done_pipe[2];
+    if (pipe(done_pipe) == -1)
+    {
+        perror("Failed to create worker pipe");
+        return -1;
+    }
+    server->workers = workers;
+    server->done_fd = done_pipe[0];
+
+    fflush(stdout);
+    for (int i = 0; i < workers; i++)
+    {
+        int job_pipe[2];
+        if (pipe(job_pipe) == -1)
+        {
+            perror("Failed to create worker pipe");
+            return -1;
+        }
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("Failed to fork worker");
+            return -1;
+        }
+        if (pid == 0)
+        {
+            close_fd(job_pipe[1]);
+            close_fd(done_pipe[0]);
+            for (int j = 0; j < i; j++)
+                close_fd(server->worker[j].job_fd);
+            server_worker(i, job_pipe[0], done_pipe[1]);
+        }
+        close_fd(job_pipe[0]);
+        fcntl(job_pipe[1], F_SETFL, fcntl(job_pipe[1], F_GETFL) | O_NONBLOCK);
+        memset(&server->worker[i], 0, sizeof(server_worker_t));
+        server->worker[i].pid = pid;
+        server->worker[i].job_fd = job_pipe[1];
+    }
+    close_fd(done_pipe[1]);
+    fcntl(server->done_fd, F_SETFL, fcntl(server->done_fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+void stop_server_workers(compute_server_t *server)
+{
+    for (int i = 0; i < server->workers; i++)
+        close_fd(server->worker[i].job_fd);
+    for (int i = 0; i < server->workers; i++)
+        while (waitpid(server->worker[i].pid, NULL, 0) == -1 && errno == EINTR)
+            ;
+    close_fd(server->done_fd);
+}
+
+//--- Job queue and dispatch ---------------------------------------------------------------------
+
+// Writes as much of the worker's current job as the pipe accepts; returns -1 on error
+int pump_worker(server_worker_t *worker)
+{
+    while (worker->job != NULL)
+    {
+        ssize_t bytes_written = write(worker->job_fd, worker->job + worker->sent, worker->length - worker->sent);
+        if (bytes_written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN ? 0 : -1;
+        }
+        worker->sent += bytes_written;
+        if (worker->sent == worker->length)
+        {
+            free(worker->job);
+            worker->job = NULL;
+        }
+    }
+    return 0;
+}
+
+// Moves queued jobs to idle workers
+int dispatch_jobs(compute_server_t *server)
+{
+    for (int i = 0; i < server->workers && server->queue_count > 0; i++)
+    {
+        server_worker_t *worker = &server->worker[i];
+        if (worker->busy)
+            continue;
+        queued_job_t *queued = &server->queue[server->queue_head];
+        server->queue_head = (server->queue_head + 1) % MAX_QUEUED_JOBS;
+        server->queue_count--;
+
+        worker->busy = 1;
+        worker->job = (char *)queued->job;
+        worker->length = queued->length;
+        worker->sent = 0;
+        worker->jobs++;
+        server->served++;
+        if (pump_worker(worker) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+// Collects the ids of workers that finished their job
+int drain_done_workers(compute_server_t *server)
+{
+    int ids[MAX_SERVER_WORKERS];
+    ssize_t bytes_read;
+    while ((bytes_read = read(server->done_fd, ids, sizeof(ids))) > 0)
+    {
+        // Each id is written in one sizeof(int) write, so reads never split them
+        for (size_t i = 0; i < bytes_read / sizeof(int); i++)
+            if (ids[i] >= 0 && ids[i] < server->workers)
+                server->worker[ids[i]].busy = 0;
+    }
+    if (bytes_read == 0 || (errno != EAGAIN && errno != EINTR))
+        return -1; // every worker exited
+    return 0;
+}
+
+//--- Request reassembly -------------------------------------------------------------------------
+
+pending_request_t *find_pending(compute_server_t *server, int pid, int create)
+{
+    pending_request_t *free_slot = NULL;
+    for (int i = 0; i < MAX_PENDING_REQUESTS; i++)
+    {
+        if (server->pending[i].pid == pid)
+            return &server->pending[i];
+        if (free_slot == NULL && server->pending[i].pid == 0)
+            free_slot = &server->pending[i];
+    }
+    return create ? free_slot : NULL;
+}
+
+void release_pending(pending_request_t *request)
+{
+    free(request->job);
+    memset(request, 0, sizeof(*request));
+}
+
+void reject_pending(compute_server_t *server, pending_request_t *request, int status)
+{
+    reply_status(request->pid, request->request_id, request->job != NULL ? request->job->op : 0, status);
+    if (status == STATUS_BUSY)
+        server->rejected++;
+    release_pending(request);
+}
+
+// Frees the slots of clients that died or went quiet mid-request; without this their slots and
+// buffers would stay taken until the table is full and every newcomer is turned away as busy
+void expire_pending(compute_server_t *server)
+{
+    uint64_t now = monotonic_ms();
+    for (int i = 0; i < MAX_PENDING_REQUESTS; i++)
+    {
+        pending_request_t *request = &server->pending[i];
+        if (request->pid == 0)
+            continue;
+        if (kill(request->pid, 0) == -1 && errno == ESRCH)
+            release_pending(request);
+        else if (now >= request->deadline_ms)
+            reject_pending(server, request, STATUS_BAD_REQUEST);
+    }
+}
+
+// Feeds one frame into its client's state. Only first frames open a request, so the rest of a
+// rejected request is dropped silently and the client gets exactly one reply.
+void handle_frame(compute_server_t *server, const request_frame_t *frame, const char *payload)
+{
+    pending_request_t *request = find_pending(server, frame->pid, frame->flags & FRAME_FIRST);
+    if (request == NULL)
+    {
+        if (frame->flags & FRAME_FIRST)
+        {
+            reply_status(frame->pid, frame->request_id, frame->op, STATUS_BUSY);
+            server->rejected++;
+        }
+        return;
+    }
+    if (frame->flags & FRAME_FIRST)
+    {
+        if (request->pid != 0)
+            release_pending(request); // client restarted a request mid-way
+        if (frame->total_length > MAX_REQUEST_BYTES || frame->total_length % sizeof(int32_t) != 0)
+        {
+            reply_status(frame->pid, frame->request_id, frame->op, STATUS_BAD_REQUEST);
+            return;
+        }
+        job_header_t *job = (job_header_t *)malloc(sizeof(job_header_t) + frame->total_length);
+        if (job == NULL)
+        {
+            reply_status(frame->pid, frame->request_id, frame->op, STATUS_BUSY);
+            server->rejected++;
+            return;
+        }
+        job->op = frame->op;
+        job->pid = frame->pid;
+        job->request_id = frame->request_id;
+        job->reserved = 0;
+        job->length = frame->total_length;
+        request->pid = frame->pid;
+        request->request_id = frame->request_id;
+        request->received = 0;
+        request->job = job;
+    }
+    if (request->request_id != frame->request_id || request->received + frame->length > request->job->length)
+    {
+        reject_pending(server, request, STATUS_BAD_REQUEST);
+        return;
+    }
+    memcpy((char *)(request->job + 1) + request->received, payload, frame->length);
+    request->received += frame->length;
+    request->deadline_ms = monotonic_ms() + PENDING_TIMEOUT_MS;
+
+    if (frame->flags & FRAME_LAST)
+    {
+        if (request->received != request->job->length)
+            reject_pending(server, request, STATUS_BAD_REQUEST);
+        else if (server->queue_count == MAX_QUEUED_JOBS)
+            reject_pending(server, request, STATUS_BUSY); // bounded backlog: push back on the client
+        else
+        {
+            queued_job_t *queued = &server->queue[(server->queue_head + server->queue_count) % MAX_QUEUED_JOBS];
+            queued->job = request->job;
+            queued->length = sizeof(job_header_t) + request->job->length;
+            server->queue_count++;
+            if (server->queue_count > server->peak_queue)
+                server->peak_queue = server->queue_count;
+            request->job = NULL;
+            release_pending(request);
+        }
+    }
+}
+
+// Parses complete frames from buffer until it runs out or the job queue fills up; returns the
+// number of bytes consumed or -1
+ssize_t handle_frames(compute_server_t *server, const char *buffer, size_t length, int *shutdown)
+{
+    size_t offset = 0;
+    while (length - offset >= sizeof(request_frame_t) && server->queue_count < MAX_QUEUED_JOBS)
+    {
+        request_frame_t frame;
+        memcpy(&frame, buffer + offset, sizeof(frame));
+        if (frame.magic != PROTOCOL_MAGIC || frame.length > FRAME_PAYLOAD_MAX)
+            return -1; // the stream cannot be resynchronised after a corrupt frame
+        if (length - offset < sizeof(frame) + frame.length)
+            break;
+        if (frame.op == OP_SHUTDOWN)
+        {
+            *shutdown = 1;
+            return offset + sizeof(frame);
+        }
+        handle_frame(server, &frame, buffer + offset + sizeof(frame));
+        offset += sizeof(frame) + frame.length;
+    }
+    return offset;
+}
+
+// Consumes the complete frames at the start of buffer and keeps the partial tail
+int parse_buffered(compute_server_t *server, char *buffer, size_t *buffered, int *shutdown)
+{
+    ssize_t consumed = handle_frames(server, buffer, *buffered, shutdown);
+    if (consumed == -1)
+    {
+        fprintf(stderr, "Server: corrupt frame on SERVER_FIFO\n");
+        *shutdown = 1;
+        return -1;
+    }
+    *buffered -= consumed;
+    memmove(buffer, buffer + consumed, *buffered);
+    return 0;
+}
+
+//--- Event loop ---------------------------------------------------------------------------------
+
+// Long-lived server: multiplexes SERVER_FIFO, the worker pipes and SIGINT/SIGTERM with poll.
+// Frames from any number of clients are reassembled, queued (at most MAX_QUEUED_JOBS, then
+// STATUS_BUSY) and handed to a pool of worker processes created once at startup.
+int run_compute_server(int workers)
+{
+    compute_server_t *server = (compute_server_t *)calloc(1, sizeof(compute_server_t));
+    char *read_buffer = (char *)malloc(SERVER_READ_BUFFER);
+    if (server == NULL || read_buffer == NULL)
+    {
+        perror("Memory allocation failed");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Workers inherit the blocked mask and stop when their job pipe closes instead
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1)
+    {
+        perror("Failed to block signals");
+        exit(EXIT_FAILURE);
+    }
+    int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1)
+    {
+        perror("Failed to create signalfd");
+        exit(EXIT_FAILURE);
+    }
+
+    create_fifo(SERVER_FIFO_PATH);
+    if (start_server_workers(server, workers) == -1)
+        exit(EXIT_FAILURE);
+
+    // Holding a write end ourselves keeps read() from returning EOF between clients
+    int server_fd = open(SERVER_FIFO_PATH, O_RDONLY | O_NONBLOCK);
+    int keepalive_fd = open(SERVER_FIFO_PATH, O_WRONLY | O_NONBLOCK);
+    if (server_fd == -1 || keepalive_fd == -1)
+    {
+        perror("Failed to open SERVER_FIFO");
+        exit(EXIT_FAILURE);
+    }
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "Server: listening on '%s' with %d workers\n", SERVER_FIFO_PATH, workers);
+    print(buffer);
+
+    enum
+    {
+        POLL_SERVER,
+        POLL_DONE,
+        POLL_SIGNAL,
+        POLL_WORKERS
+    };
+    struct pollfd fds[POLL_WORKERS + MAX_SERVER_WORKERS];
+    size_t buffered = 0;
+    int shutdown = 0;
+    int status = 0;
+    uint64_t next_sweep = monotonic_ms() + PENDING_SWEEP_MS;
+    while (!shutdown)
+    {
+        // A full queue stops reading SERVER_FIFO; clients then block on the full pipe
+        fds[POLL_SERVER] = (struct pollfd){server_fd, server->queue_count < MAX_QUEUED_JOBS ? POLLIN : 0, 0};
+        fds[POLL_DONE] = (struct pollfd){server->done_fd, POLLIN, 0};
+        fds[POLL_SIGNAL] = (struct pollfd){signal_fd, POLLIN, 0};
+        for (int i = 0; i < workers; i++)
+            fds[POLL_WORKERS + i] = (struct pollfd){server->worker[i].job != NULL ? server->worker[i].job_fd : -1, POLLOUT, 0};
+        // Wakes at least every PENDING_SWEEP_MS so abandoned requests expire on an idle server too
+        if (poll(fds, POLL_WORKERS + workers, PENDING_SWEEP_MS) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("poll failed");
+            status = 1;
+            break;
+        }
+        if (monotonic_ms() >= next_sweep)
+        {
+            expire_pending(server);
+            next_sweep = monotonic_ms() + PENDING_SWEEP_MS;
+        }
+
+        if (fds[POLL_SIGNAL].revents & POLLIN)
+        {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info))
+                shutdown = 1;
+        }
+        if (fds[POLL_DONE].revents & (POLLIN | POLLHUP))
+        {
+            if (drain_done_workers(server) == -1)
+            {
+                fprintf(stderr, "Server: worker pool exited\n");
+                status = 1;
+                break;
+            }
+        }
+        for (int i = 0; i < workers; i++)
+        {
+            if ((fds[POLL_WORKERS + i].revents & (POLLOUT | POLLERR)) && pump_worker(&server->worker[i]) == -1)
+            {
+                perror("Failed to write a job to a worker");
+                status = 1;
+                shutdown = 1;
+            }
+        }
+        if (!shutdown && (fds[POLL_SERVER].revents & POLLIN))
+        {
+            ssize_t bytes_read;
+            while ((bytes_read = read(server_fd, read_buffer + buffered, SERVER_READ_BUFFER - buffered)) > 0)
+            {
+                buffered += bytes_read;
+                if (parse_buffered(server, read_buffer, &buffered, &shutdown) == -1)
+                {
+                    status = 1;
+                    break;
+                }
+                if (shutdown || server->queue_count == MAX_QUEUED_JOBS)
+                    break; // let the workers catch up before reading more
+            }
+        }
+        if (dispatch_jobs(server) == -1)
+        {
+            perror("Failed to write a job to a worker");
+            status = 1;
+            break;
+        }
+        // Frames left over from a full queue are parsed as soon as workers free up slots
+        if (!shutdown && buffered > 0 && server->queue_count < MAX_QUEUED_JOBS &&
+            parse_buffered(server, read_buffer, &buffered, &shutdown) == -1)
+        {
+            status = 1;
+            break;
+        }
+    }
+
+    //--- Shut down: refuse the backlog, finish in-flight jobs, stop the workers -------------
+    close_fd(keepalive_fd);
+    close_fd(server_fd);
+    remove_fifo(SERVER_FIFO_PATH);
+    while (server->queue_count > 0)
+    {
+        queued_job_t *queued = &server->queue[server->queue_head];
+        reply_status(queued->job->pid, queued->job->request_id, queued->job->op, STATUS_BUSY);
+        free(queued->job);
+        server->queue_head = (server->queue_head + 1) % MAX_QUEUED_JOBS;
+        server->queue_count--;
+        server->rejected++;
+    }
+    for (int i = 0; i < MAX_PENDING_REQUESTS; i++)
+        if (server->pending[i].pid != 0)
+            release_pending(&server->pending[i]);
+    for (int i = 0; i < workers; i++)
+    {
+        server_worker_t *worker = &server->worker[i];
+        if (worker->job == NULL)
+            continue;
+        fcntl(worker->job_fd, F_SETFL, fcntl(worker->job_fd, F_GETFL) & ~O_NONBLOCK);
+        if (pump_worker(worker) == -1)
+        {
+            free(worker->job);
+            worker->job = NULL;
+        }
+    }
+    stop_server_workers(server);
+    close_fd(signal_fd);
+
+    snprintf(buffer, sizeof(buffer), "Server: %lu requests served, %lu rejected as busy, peak queue depth %d\n",
+             server->served, server->rejected, server->peak_queue);
+    print(buffer);
+    for (int i = 0; i < workers; i++)
+    {
+        snprintf(buffer, sizeof(buffer), "  worker %d (pid %d): %lu jobs\n", i, (int)server->worker[i].pid, server->worker[i].jobs);
+        print(buffer);
+    }
+    free(read_buffer);
+    free(server);
+    return status;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _SHM_UTILS_H
+#define _SHM_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define SHM_NAME_SIZE 64
+#define SHM_NUMBERS_PREFIX "/hw2_numbers"
+
+// Control message sent over FIFO1/FIFO2 instead of the array itself.
+typedef struct
+{
+    char shm_name[SHM_NAME_SIZE];
+    int arr_size;
+} shm_descriptor_t;
+
+int *create_shm_array(const char *shm_name, int arr_size)
+{
+    size_t size = (size_t)arr_size * sizeof(int);
+    int shm_fd = shm_open(shm_name, O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (shm_fd == -1)
+    {
+        perror("Failed to create shared memory");
+        exit(EXIT_FAILURE);
+    }
+    if (ftruncate(shm_fd, size) == -1)
+    {
+        perror("Failed to set size of shared memory");
+        close(shm_fd);
+        shm_unlink(shm_name);
+        exit(EXIT_FAILURE);
+    }
+    int *shm_ptr = (int *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (shm_ptr == MAP_FAILED)
+    {
+        perror("Failed to map shared memory");
+        close(shm_fd);
+        shm_unlink(shm_name);
+        exit(EXIT_FAILURE);
+    }
+    close(shm_fd);
+    return shm_ptr;
+}
+
+const int *attach_shm_array(const char *shm_name, int arr_size)
+{
+    size_t size = (size_t)arr_size * sizeof(int);
+    int shm_fd = shm_open(shm_name, O_RDONLY, 0);
+    if (shm_fd == -1)
+    {
+        perror("Failed to open shared memory");
+        return NULL;
+    }
+    const int *shm_ptr = (const int *)mmap(NULL, size, PROT_READ, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (shm_ptr == MAP_FAILED)
+    {
+        perror("Failed to map shared memory");
+        return NULL;
+    }
+    return shm_ptr;
+}
+
+void detach_shm_array(const int *shm_ptr, int arr_size)
+{
+    if (munmap((void *)shm_ptr, (size_t)arr_size * sizeof(int)) == -1)
+    {
+        perror("Failed to unmap shared memory");
+    }
+}
+
+void remove_shm_array(const char *shm_name)
+{
+    if (shm_unlink(shm_name) == -1)
+    {
+        perror("Failed to unlink shared memory");
+    }
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef _STREAM_UTILS_H
+#define _STREAM_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <string.h>
+
+#include "fifo_utils.h"
+
+#define DEFAULT_CHUNK_SIZE (64 * 1024)
+
+// Every chunk on the wire is a header followed by `length` payload bytes.
+// A header with length 0 terminates the stream.
+typedef struct
+{
+    uint32_t seq;
+    uint32_t length;
+} chunk_header_t;
+
+// Called once per received chunk so the reader can reduce while data is still in flight
+typedef void (*chunk_fold_fn)(const int *values, size_t count, void *ctx);
+
+size_t normalize_chunk_size(long chunk_size)
+{
+    if (chunk_size < (long)sizeof(int))
+        return sizeof(int);
+    if (chunk_size > UINT32_MAX)
+        chunk_size = UINT32_MAX;
+    return (size_t)chunk_size - (size_t)chunk_size % sizeof(int);
+}
+
+// Set once vmsplice is refused so the remaining payloads go through plain write
+int vmsplice_unsupported = 0;
+
+// Maps the user pages into the pipe instead of copying them. Page-aligned whole pages are
+// gifted; the caller must not modify or free the buffer until the readers consumed it.
+ssize_t vmsplice_with_retry(int fd, const void *buf, size_t count)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t total = 0;
+    while (total < count && !vmsplice_unsupported)
+    {
+        struct iovec iov;
+        iov.iov_base = (char *)buf + total;
+        iov.iov_len = count - total;
+        unsigned int flags = 0;
+        if ((uintptr_t)iov.iov_base % page_size == 0 && iov.iov_len % page_size == 0)
+            flags = SPLICE_F_GIFT;
+
+        ssize_t bytes_spliced = vmsplice(fd, &iov, 1, flags);
+        if (bytes_spliced == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EINVAL || errno == ENOSYS || errno == EBADF)
+            {
+                vmsplice_unsupported = 1;
+                break;
+            }
+            perror("Failed to vmsplice to FIFO");
+            return -1;
+        }
+        total += bytes_spliced;
+    }
+    if (total < count && write_fifo_with_retry(fd, (const char *)buf + total, count - total) == -1)
+        return -1;
+    return count;
+}
+
+// Sends count numbers as fixed-size chunks; returns the number of data chunks or -1.
+// With zero_copy the payloads are vmspliced, headers always use write.
+ssize_t stream_numbers(int fd, const int *numbers, size_t count, size_t chunk_size, int zero_copy)
+{
+    size_t per_chunk = chunk_size / sizeof(int);
+    chunk_header_t header = {0, 0};
+
+    for (size_t offset = 0; offset < count; offset += per_chunk)
+    {
+        size_t values = count - offset < per_chunk ? count - offset : per_chunk;
+        header.length = values * sizeof(int);
+        if (write_fifo_with_retry(fd, &header, sizeof(header)) == -1)
+            return -1;
+        if (zero_copy)
+        {
+            if (vmsplice_with_retry(fd, numbers + offset, header.length) == -1)
+                return -1;
+        }
+        else if (write_fifo_with_retry(fd, numbers + offset, header.length) == -1)
+            return -1;
+        header.seq++;
+    }
+
+    ssize_t chunks = header.seq;
+    header.length = 0;
+    if (write_fifo_with_retry(fd, &header, sizeof(header)) == -1)
+        return -1;
+    return chunks;
+}
+
+typedef enum
+{
+    WRITER_PREFIX,
+    WRITER_HEADER,
+    WRITER_PAYLOAD,
+    WRITER_DONE
+} writer_stage_t;
+
+// Non-blocking counterpart of stream_numbers for one thread feeding several pipes through poll:
+// an optional prefix message, then (when streaming) the same chunk framing, written in whatever
+// pieces the pipe accepts. The fd must be O_NONBLOCK.
+typedef struct
+{
+    int fd;
+    const int *numbers;
+    size_t count;
+    size_t per_chunk;
+    size_t offset; // values already framed
+    int streaming; // 0: only the prefix is sent
+    int zero_copy;
+    writer_stage_t stage;
+    chunk_header_t header;
+    const char *piece; // bytes being written now
+    size_t length;
+    size_t sent;
+    int splice; // the current piece is a payload to vmsplice
+} stream_writer_t;
+
+void stream_writer_init(stream_writer_t *writer, int fd, const void *prefix, size_t prefix_len, const int *numbers, size_t count,
+                        size_t chunk_size, int streaming, int zero_copy)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->fd = fd;
+    writer->numbers = numbers;
+    writer->count = count;
+    writer->per_chunk = chunk_size / sizeof(int);
+    writer->streaming = streaming;
+    writer->zero_copy = zero_copy;
+    writer->stage = WRITER_PREFIX;
+    writer->piece = (const char *)prefix;
+    writer->length = prefix_len;
+}
+
+// Moves on to the next piece; returns 0 once the stream is complete
+static int stream_writer_next(stream_writer_t *writer)
+{
+    writer->sent = 0;
+    writer->splice = 0;
+    if (writer->stage == WRITER_HEADER)
+    {
+        if (writer->header.length == 0)
+        {
+            writer->stage = WRITER_DONE;
+            return 0;
+        }
+        writer->piece = (const char *)(writer->numbers + writer->offset);
+        writer->length = writer->header.length;
+        writer->splice = writer->zero_copy && !vmsplice_unsupported;
+        writer->offset += writer->header.length / sizeof(int);
+        writer->header.seq++;
+        writer->stage = WRITER_PAYLOAD;
+        return 1;
+    }
+    if (writer->stage == WRITER_DONE || !writer->streaming)
+    {
+        writer->stage = WRITER_DONE;
+        return 0;
+    }
+    // After the prefix or a payload: the next header, or the terminator once every value is out
+    size_t values = writer->count - writer->offset < writer->per_chunk ? writer->count - writer->offset : writer->per_chunk;
+    writer->header.length = values * sizeof(int);
+    writer->piece = (const char *)&writer->header;
+    writer->length = sizeof(writer->header);
+    writer->stage = WRITER_HEADER;
+    return 1;
+}
+
+// Writes until the pipe is full; returns 1 once the whole stream is out, 0 when it would block
+// and -1 on error
+int stream_writer_step(stream_writer_t *writer)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    for (;;)
+    {
+        if (writer->sent == writer->length)
+        {
+            if (!stream_writer_next(writer))
+                return 1;
+            continue;
+        }
+        ssize_t written;
+        if (writer->splice)
+        {
+            struct iovec iov;
+            iov.iov_base = (char *)writer->piece + writer->sent;
+            iov.iov_len = writer->length - writer->sent;
+            unsigned int flags = SPLICE_F_NONBLOCK;
+            if ((uintptr_t)iov.iov_base % page_size == 0 && iov.iov_len % page_size == 0)
+                flags |= SPLICE_F_GIFT;
+            written = vmsplice(writer->fd, &iov, 1, flags);
+            if (written == -1 && (errno == EINVAL || errno == ENOSYS || errno == EBADF))
+            {
+                vmsplice_unsupported = 1;
+                writer->splice = 0;
+                continue;
+            }
+        }
+        else
+            written = write(writer->fd, writer->piece + writer->sent, writer->length - writer->sent);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+                return 0;
+            perror("Failed to write to FIFO");
+            return -1;
+        }
+        writer->sent += written;
+    }
+}
+
+// Reads chunks until the terminator and folds each one; returns the number of values or -1
+ssize_t receive_stream(int fd, size_t chunk_size, chunk_fold_fn fold, void *ctx)
+{
+    int *chunk = (int *)malloc(chunk_size);
+    if (chunk == NULL)
+        return -1;
+
+    chunk_header_t header;
+    uint32_t expected_seq = 0;
+    size_t total = 0;
+    for (;;)
+    {
+        if (read_fifo_with_retry(fd, &header, sizeof(header)) != sizeof(header))
+            break;
+        if (header.seq != expected_seq || header.length > chunk_size || header.length % sizeof(int) != 0)
+            break;
+        if (header.length == 0)
+        {
+            free(chunk);
+            return total;
+        }
+        if (read_fifo_with_retry(fd, chunk, header.length) != header.length)
+            break;
+
+        fold(chunk, header.length / sizeof(int), ctx);
+        total += header.length / sizeof(int);
+        expected_seq++;
+    }
+
+    free(chunk);
+    errno = EPROTO;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _TIMING_UTILS_H
+#define _TIMING_UTILS_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "fifo_utils.h"
+
+#define MAX_PHASES 8
+
+typedef struct
+{
+    const char *name;
+    struct timespec wall_start;
+    struct timespec wall_end;
+    struct rusage self_start;
+    struct rusage self_end;
+    struct rusage children_start;
+    struct rusage children_end;
+} phase_t;
+
+double timespec_diff_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+long phase_faults(const struct rusage *start, const struct rusage *end, int major)
+{
+    return major ? end->ru_majflt - start->ru_majflt : end->ru_minflt - start->ru_minflt;
+}
+
+double rusage_cpu_ms(const struct rusage *usage)
+{
+    return (usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1e3 +
+           (usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e3;
+}
+
+void phase_begin(phase_t *phase, const char *name)
+{
+    phase->name = name;
+    getrusage(RUSAGE_SELF, &phase->self_start);
+    getrusage(RUSAGE_CHILDREN, &phase->children_start);
+    clock_gettime(CLOCK_MONOTONIC, &phase->wall_start);
+}
+
+void phase_end(phase_t *phase)
+{
+    clock_gettime(CLOCK_MONOTONIC, &phase->wall_end);
+    getrusage(RUSAGE_SELF, &phase->self_end);
+    getrusage(RUSAGE_CHILDREN, &phase->children_end);
+}
+
+// Child CPU time and page faults only show up once the children are reaped, so they land in the
+// phase that waits for them
+void print_phase_report(const phase_t *phases, int count)
+{
+    char buffer[256];
+    print("Phase timings:\n");
+    snprintf(buffer, sizeof(buffer), "  %-12s %12s %16s %16s %12s %12s\n", "phase", "wall (ms)", "parent cpu (ms)", "child cpu (ms)",
+             "minor flt", "major flt");
+    print(buffer);
+    for (int i = 0; i < count; i++)
+    {
+        const phase_t *phase = &phases[i];
+        snprintf(buffer, sizeof(buffer), "  %-12s %12.3f %16.3f %16.3f %12ld %12ld\n", phase->name,
+                 timespec_diff_ms(&phase->wall_start, &phase->wall_end),
+                 rusage_cpu_ms(&phase->self_end) - rusage_cpu_ms(&phase->self_start),
+                 rusage_cpu_ms(&phase->children_end) - rusage_cpu_ms(&phase->children_start),
+                 phase_faults(&phase->self_start, &phase->self_end, 0) + phase_faults(&phase->children_start, &phase->children_end, 0),
+                 phase_faults(&phase->self_start, &phase->self_end, 1) + phase_faults(&phase->children_start, &phase->children_end, 1));
+        print(buffer);
+    }
+}
+
+#endif
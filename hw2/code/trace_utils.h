@@ -0,0 +1,168 @@
+#ifndef _TRACE_UTILS_H
+#define _TRACE_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define TRACE_CAPACITY 256
+#define TRACE_NAME_SIZE 32
+#define TRACE_LABEL_SIZE 32
+
+// One fixed-size record per tracepoint; type is a Chrome trace phase ('B', 'E' or 'i')
+typedef struct
+{
+    uint64_t ts_ns;
+    char type;
+    char name[TRACE_NAME_SIZE - 1];
+} trace_event_t;
+
+// Each process appends only to its own buffer, so recording needs no locking. The buffers live
+// in one MAP_SHARED region created before fork, which lets the parent merge them after the
+// children exit without any extra IPC.
+typedef struct
+{
+    int32_t pid;
+    uint32_t count;
+    uint32_t dropped;
+    char label[TRACE_LABEL_SIZE];
+    trace_event_t events[TRACE_CAPACITY];
+} trace_buffer_t;
+
+trace_buffer_t *trace_buffers = NULL;
+int trace_processes = 0;
+trace_buffer_t *trace_self = NULL;
+
+// Maps buffers for the given number of processes; returns 0 or -1
+int trace_init(int processes)
+{
+    size_t size = processes * sizeof(trace_buffer_t);
+    trace_buffers = (trace_buffer_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (trace_buffers == MAP_FAILED)
+    {
+        trace_buffers = NULL;
+        return -1;
+    }
+    trace_processes = processes;
+    return 0;
+}
+
+// Binds the calling process to a buffer slot; tracepoints are no-ops until this is called
+void trace_attach(int slot, const char *label)
+{
+    if (trace_buffers == NULL || slot >= trace_processes)
+        return;
+    trace_self = &trace_buffers[slot];
+    trace_self->pid = getpid();
+    trace_self->count = 0;
+    trace_self->dropped = 0;
+    snprintf(trace_self->label, TRACE_LABEL_SIZE, "%s", label);
+}
+
+void trace_event(char type, const char *name)
+{
+    if (trace_self == NULL)
+        return;
+    if (trace_self->count == TRACE_CAPACITY)
+    {
+        trace_self->dropped++;
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    trace_event_t *event = &trace_self->events[trace_self->count];
+    event->ts_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    event->type = type;
+    snprintf(event->name, sizeof(event->name), "%s", name);
+    trace_self->count++;
+}
+
+void trace_begin(const char *name)
+{
+    trace_event('B', name);
+}
+
+void trace_end(const char *name)
+{
+    trace_event('E', name);
+}
+
+void trace_instant(const char *name)
+{
+    trace_event('i', name);
+}
+
+typedef struct
+{
+    const trace_buffer_t *buffer;
+    const trace_event_t *event;
+} trace_ref_t;
+
+int compare_trace_refs(const void *a, const void *b)
+{
+    uint64_t ta = ((const trace_ref_t *)a)->event->ts_ns;
+    uint64_t tb = ((const trace_ref_t *)b)->event->ts_ns;
+    return ta < tb ? -1 : ta > tb;
+}
+
+// Merges every buffer into one Chrome trace-event JSON file (chrome://tracing, Perfetto), with
+// timestamps in microseconds relative to the earliest event. Returns 0 or -1.
+int trace_write_json(const char *path)
+{
+    size_t total = 0;
+    for (int i = 0; i < trace_processes; i++)
+        total += trace_buffers[i].count;
+    trace_ref_t *refs = (trace_ref_t *)malloc((total > 0 ? total : 1) * sizeof(trace_ref_t));
+    if (refs == NULL)
+        return -1;
+    size_t n = 0;
+    for (int i = 0; i < trace_processes; i++)
+        for (uint32_t j = 0; j < trace_buffers[i].count; j++)
+            refs[n++] = (trace_ref_t){&trace_buffers[i], &trace_buffers[i].events[j]};
+    qsort(refs, total, sizeof(trace_ref_t), compare_trace_refs);
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        free(refs);
+        return -1;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+    for (int i = 0; i < trace_processes; i++)
+    {
+        if (trace_buffers[i].pid == 0)
+            continue;
+        fprintf(file, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", trace_buffers[i].pid, trace_buffers[i].pid, trace_buffers[i].label);
+        fprintf(file, ",\n{\"name\":\"process_sort_index\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+                trace_buffers[i].pid, trace_buffers[i].pid, i);
+        first = 0;
+    }
+    uint64_t origin = total > 0 ? refs[0].event->ts_ns : 0;
+    for (size_t i = 0; i < total; i++)
+    {
+        const trace_event_t *event = refs[i].event;
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d%s}", first ? "" : ",\n", event->name,
+                event->type, (event->ts_ns - origin) / 1e3, refs[i].buffer->pid, refs[i].buffer->pid,
+                event->type == 'i' ? ",\"s\":\"p\"" : "");
+        first = 0;
+    }
+    fprintf(file, "\n]}\n");
+    free(refs);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+void trace_release()
+{
+    if (trace_buffers != NULL)
+        munmap(trace_buffers, trace_processes * sizeof(trace_buffer_t));
+    trace_buffers = NULL;
+    trace_self = NULL;
+}
+
+#endif
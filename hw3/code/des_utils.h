@@ -0,0 +1,290 @@
+#ifndef _DES_UTILS_H
+#define _DES_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "parking_utils.h"
+
+#define VEHICLE_TYPES 2 // 0 for automobile, 1 for pickup
+#define DEFAULT_STAY_US 2000000
+
+typedef enum
+{
+    EVENT_ARRIVAL,       // a vehicle reaches the lot; also schedules the next arrival
+    EVENT_PARK_COMPLETE, // the attendant finished parking a vehicle
+    EVENT_DEPARTURE,     // a parked vehicle leaves and frees its spot
+    EVENT_TYPE_COUNT
+} EventType;
+
+typedef struct
+{
+    uint64_t time; // virtual microseconds
+    uint64_t seq;  // insertion order, breaks ties so equal-time events always pop the same way
+    int type;
+    int vehicleType;
+    int vehicleId;
+} Event;
+
+// Binary min-heap on (time, seq)
+typedef struct
+{
+    Event *events;
+    size_t count;
+    size_t capacity;
+    uint64_t nextSeq;
+} EventCalendar;
+
+// xoshiro256** seeded through splitmix64; the simulation never touches rand()
+typedef struct
+{
+    uint64_t s[4];
+} SimRandom;
+
+typedef struct
+{
+    uint64_t seed;
+    int vehicles;
+    int arrivalDelay;   // inter-arrival gaps are uniform in [0, arrivalDelay) us
+    int attendantDelay; // parking one vehicle takes [0, attendantDelay) us
+    int stayTime;       // parked vehicles stay [0, stayTime) us
+} SimConfig;
+
+typedef struct
+{
+    long arrivals[VEHICLE_TYPES];
+    long parked[VEHICLE_TYPES];
+    long rejected[VEHICLE_TYPES];
+    long departures[VEHICLE_TYPES];
+    long events[EVENT_TYPE_COUNT];
+    uint64_t endTime;
+    uint64_t checksum; // FNV-1a over every processed event, equal seeds give equal checksums
+} SimStats;
+
+// Vehicles waiting for their type's attendant, in arrival order
+typedef struct
+{
+    int *ids;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} VehicleQueue;
+
+uint64_t sim_splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void sim_random_seed(SimRandom *rng, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        rng->s[i] = sim_splitmix64(&seed);
+}
+
+uint64_t sim_random_next(SimRandom *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t x = s[1] * 5;
+    uint64_t result = ((x << 7) | (x >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+// Uniform in [0, bound); 0 when bound is 0
+uint64_t sim_uniform(SimRandom *rng, uint64_t bound)
+{
+    return bound == 0 ? 0 : sim_random_next(rng) % bound;
+}
+
+void calendar_init(EventCalendar *calendar)
+{
+    calendar->events = NULL;
+    calendar->count = 0;
+    calendar->capacity = 0;
+    calendar->nextSeq = 0;
+}
+
+static inline int event_before(const Event *a, const Event *b)
+{
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+void calendar_push(EventCalendar *calendar, uint64_t time, int type, int vehicleType, int vehicleId)
+{
+    if (calendar->count == calendar->capacity)
+    {
+        calendar->capacity = calendar->capacity == 0 ? 64 : calendar->capacity * 2;
+        calendar->events = (Event *)realloc(calendar->events, calendar->capacity * sizeof(Event));
+        if (calendar->events == NULL)
+        {
+            perror("Failed to grow event calendar");
+            exit(EXIT_FAILURE);
+        }
+    }
+    Event event = {time, calendar->nextSeq++, type, vehicleType, vehicleId};
+    size_t i = calendar->count++;
+    while (i > 0 && event_before(&event, &calendar->events[(i - 1) / 2]))
+    {
+        calendar->events[i] = calendar->events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    calendar->events[i] = event;
+}
+
+// Removes the earliest event; returns 0 when the calendar is empty
+int calendar_pop(EventCalendar *calendar, Event *event)
+{
+    if (calendar->count == 0)
+        return 0;
+    *event = calendar->events[0];
+    Event last = calendar->events[--calendar->count];
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= calendar->count)
+            break;
+        if (child + 1 < calendar->count && event_before(&calendar->events[child + 1], &calendar->events[child]))
+            child++;
+        if (!event_before(&calendar->events[child], &last))
+            break;
+        calendar->events[i] = calendar->events[child];
+        i = child;
+    }
+    calendar->events[i] = last;
+    return 1;
+}
+
+void calendar_free(EventCalendar *calendar)
+{
+    free(calendar->events);
+    calendar_init(calendar);
+}
+
+void vehicle_queue_push(VehicleQueue *queue, int id)
+{
+    if (queue->count == queue->capacity)
+    {
+        size_t capacity = queue->capacity == 0 ? 16 : queue->capacity * 2;
+        int *ids = (int *)malloc(capacity * sizeof(int));
+        if (ids == NULL)
+        {
+            perror("Failed to grow vehicle queue");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < queue->count; i++)
+            ids[i] = queue->ids[(queue->head + i) % queue->capacity];
+        free(queue->ids);
+        queue->ids = ids;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+    queue->ids[(queue->head + queue->count) % queue->capacity] = id;
+    queue->count++;
+}
+
+int vehicle_queue_pop(VehicleQueue *queue, int *id)
+{
+    if (queue->count == 0)
+        return 0;
+    *id = queue->ids[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    return 1;
+}
+
+static inline void checksum_event(uint64_t *hash, const Event *event)
+{
+    uint64_t words[3] = {event->time, (uint64_t)event->type << 32 | (uint32_t)event->vehicleType, (uint64_t)event->vehicleId};
+    const unsigned char *bytes = (const unsigned char *)words;
+    for (size_t i = 0; i < sizeof(words); i++)
+        *hash = (*hash ^ bytes[i]) * 0x100000001B3ULL;
+}
+
+// Same lot as the threaded simulation (MAX_AUTOMOBILES / MAX_PICKUPS spots, one attendant per
+// vehicle type), driven by a virtual clock: every state change is an event on the calendar and
+// time jumps straight to the next one, so the run is as fast as the CPU and fully determined
+// by the seed.
+void run_event_simulation(const SimConfig *config, SimStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->checksum = 0xCBF29CE484222325ULL;
+
+    SimRandom rng;
+    sim_random_seed(&rng, config->seed);
+    EventCalendar calendar;
+    calendar_init(&calendar);
+    int freeSpots[VEHICLE_TYPES] = {MAX_AUTOMOBILES, MAX_PICKUPS};
+    int attendantBusy[VEHICLE_TYPES] = {0, 0};
+    VehicleQueue waiting[VEHICLE_TYPES];
+    memset(waiting, 0, sizeof(waiting));
+
+    int nextVehicle = 0;
+    if (config->vehicles > 0)
+        calendar_push(&calendar, 0, EVENT_ARRIVAL, (int)sim_uniform(&rng, VEHICLE_TYPES), nextVehicle++);
+
+    Event event;
+    while (calendar_pop(&calendar, &event))
+    {
+        uint64_t now = event.time;
+        int type = event.vehicleType;
+        stats->events[event.type]++;
+        checksum_event(&stats->checksum, &event);
+
+        switch (event.type)
+        {
+        case EVENT_ARRIVAL:
+            if (nextVehicle < config->vehicles)
+                calendar_push(&calendar, now + sim_uniform(&rng, config->arrivalDelay), EVENT_ARRIVAL,
+                              (int)sim_uniform(&rng, VEHICLE_TYPES), nextVehicle++);
+            stats->arrivals[type]++;
+            if (freeSpots[type] == 0)
+            {
+                stats->rejected[type]++;
+                break;
+            }
+            freeSpots[type]--;
+            if (attendantBusy[type])
+                vehicle_queue_push(&waiting[type], event.vehicleId);
+            else
+            {
+                attendantBusy[type] = 1;
+                calendar_push(&calendar, now + sim_uniform(&rng, config->attendantDelay), EVENT_PARK_COMPLETE, type, event.vehicleId);
+            }
+            break;
+        case EVENT_PARK_COMPLETE:
+        {
+            stats->parked[type]++;
+            calendar_push(&calendar, now + sim_uniform(&rng, config->stayTime), EVENT_DEPARTURE, type, event.vehicleId);
+            int next;
+            if (vehicle_queue_pop(&waiting[type], &next))
+                calendar_push(&calendar, now + sim_uniform(&rng, config->attendantDelay), EVENT_PARK_COMPLETE, type, next);
+            else
+                attendantBusy[type] = 0;
+            break;
+        }
+        case EVENT_DEPARTURE:
+            stats->departures[type]++;
+            freeSpots[type]++;
+            break;
+        }
+        stats->endTime = now;
+    }
+
+    calendar_free(&calendar);
+    for (int i = 0; i < VEHICLE_TYPES; i++)
+        free(waiting[i].ids);
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef _LOG_UTILS_H
+#define _LOG_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LOG_FIRST_CHUNK 32 // short-lived threads log a handful of events, long-lived ones grow to LOG_CHUNK_RECORDS
+#define LOG_CHUNK_RECORDS 4096
+#define LOG_OUTPUT_SIZE 65536
+#define LOG_LINE_SIZE 256
+#define LOG_FLUSH_INTERVAL_NS 20000000LL // the flusher thread wakes every 20 ms
+#define LOG_MERGE_WINDOW_NS 50000000ULL  // younger records wait for other threads' records of the same moment
+
+typedef enum
+{
+    LOG_OWNER_ATTEMPT,
+    LOG_OWNER_FOUND,    // count: spots left
+    LOG_OWNER_PARKED,
+    LOG_OWNER_NO_SPACE,
+    LOG_OWNER_NO_ROOM,  // lot and wait queue both full
+    LOG_OWNER_WAITING,
+    LOG_OWNER_GAVE_UP,  // value: microseconds waited
+    LOG_ATTENDANT_PARKED,  // count: spots available
+    LOG_ATTENDANT_STAYING, // count: spots available, value: stay in microseconds
+    LOG_DEPARTURE,         // count: spots available
+    LOG_EVENT_COUNT
+} LogEventType;
+
+typedef struct
+{
+    uint64_t timeNs;
+    int64_t value;
+    int32_t thread;
+    uint32_t seq; // per thread, keeps same-timestamp records of a thread in order
+    int16_t count;
+    int16_t lot;
+    int16_t spot;
+    uint8_t type;
+    uint8_t vehicleType;
+} LogRecord;
+
+// A thread appends to its own chunk only and publishes each record by bumping count, so
+// recording needs neither a lock nor a syscall. The flusher thread copies out what was published
+// since its last pass and frees a chunk once its owner has retired it (moved on to a new chunk,
+// or exited), so memory stays bounded however long the run is.
+typedef struct LogChunk
+{
+    atomic_int count;
+    atomic_int retired; // LOG_CHUNK_LIVE, LOG_CHUNK_RETIRED or LOG_CHUNK_ABANDONED
+    int flushed; // records already taken by the flusher
+    int capacity;
+    struct LogChunk *next;
+    LogRecord records[];
+} LogChunk;
+
+// A detached thread can still be in its key destructor when the final flush runs. That flush
+// abandons the chunks not retired yet instead of freeing them, and whichever side comes second
+// frees the chunk.
+enum
+{
+    LOG_CHUNK_LIVE,
+    LOG_CHUNK_RETIRED,
+    LOG_CHUNK_ABANDONED // unlinked by the final flush, freed by its owner's retire
+};
+
+typedef int (*LogFormatter)(const LogRecord *record, char *line, size_t size);
+
+LogChunk *log_chunks = NULL;
+int log_threads = 0;
+pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_key_t log_key;
+pthread_once_t log_key_once = PTHREAD_ONCE_INIT;
+_Thread_local LogChunk *log_current = NULL;
+_Thread_local int log_thread = -1;
+_Thread_local uint32_t log_seq = 0;
+
+// Records taken from the chunks but not written yet, kept for the merge window
+LogRecord *log_pending = NULL;
+size_t log_pending_count = 0;
+size_t log_pending_capacity = 0;
+
+pthread_t log_flusher;
+int log_flusher_running = 0;
+int log_flusher_stop = 0;
+pthread_cond_t log_flusher_wake = PTHREAD_COND_INITIALIZER;
+int log_fd = -1;
+LogFormatter log_format = NULL;
+
+static void log_retire(void *chunk)
+{
+    if (atomic_exchange_explicit(&((LogChunk *)chunk)->retired, LOG_CHUNK_RETIRED, memory_order_acq_rel) == LOG_CHUNK_ABANDONED)
+        free(chunk);
+}
+
+static void log_create_key()
+{
+    pthread_key_create(&log_key, log_retire); // an exiting thread retires its last chunk
+}
+
+static LogChunk *log_new_chunk(int capacity)
+{
+    LogChunk *chunk = (LogChunk *)malloc(sizeof(LogChunk) + capacity * sizeof(LogRecord));
+    if (chunk == NULL)
+    {
+        perror("Failed to allocate log chunk");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&chunk->count, 0);
+    atomic_init(&chunk->retired, LOG_CHUNK_LIVE);
+    chunk->flushed = 0;
+    chunk->capacity = capacity;
+    pthread_once(&log_key_once, log_create_key);
+    pthread_setspecific(log_key, chunk);
+    pthread_mutex_lock(&log_lock);
+    if (log_thread == -1)
+        log_thread = log_threads++;
+    chunk->next = log_chunks;
+    log_chunks = chunk;
+    pthread_mutex_unlock(&log_lock);
+    return chunk;
+}
+
+void log_record(LogEventType type, int vehicleType, int lot, int spot, int count, int64_t value)
+{
+    if (log_current == NULL)
+        log_current = log_new_chunk(LOG_FIRST_CHUNK);
+    else if (atomic_load_explicit(&log_current->count, memory_order_relaxed) == log_current->capacity)
+    {
+        LogChunk *full = log_current;
+        log_current = log_new_chunk(full->capacity < LOG_CHUNK_RECORDS ? full->capacity * 2 : LOG_CHUNK_RECORDS);
+        log_retire(full); // never touched by this thread again
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now); // vDSO, no syscall
+    int index = atomic_load_explicit(&log_current->count, memory_order_relaxed);
+    LogRecord *record = &log_current->records[index];
+    record->timeNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    record->value = value;
+    record->thread = log_thread;
+    record->seq = log_seq++;
+    record->count = (int16_t)count;
+    record->lot = (int16_t)lot;
+    record->spot = (int16_t)spot;
+    record->type = (uint8_t)type;
+    record->vehicleType = (uint8_t)vehicleType;
+    atomic_store_explicit(&log_current->count, index + 1, memory_order_release);
+}
+
+static int log_compare(const void *a, const void *b)
+{
+    const LogRecord *x = (const LogRecord *)a, *y = (const LogRecord *)b;
+    if (x->timeNs != y->timeNs)
+        return x->timeNs < y->timeNs ? -1 : 1;
+    if (x->thread != y->thread)
+        return x->thread < y->thread ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static void log_write(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Failed to write log");
+            return;
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+// Moves every published record into log_pending and frees the retired chunks. With all set, every
+// chunk leaves the list, which is only safe once no other thread of the process is logging; the
+// caller's own chunk is freed too, and the ones whose owners have not retired them yet are
+// abandoned to those owners.
+static void log_collect(int all)
+{
+    pthread_mutex_lock(&log_lock);
+    LogChunk **link = &log_chunks;
+    while (*link != NULL)
+    {
+        LogChunk *chunk = *link;
+        int retired = atomic_load_explicit(&chunk->retired, memory_order_acquire); // before count, so count is final
+        int count = atomic_load_explicit(&chunk->count, memory_order_acquire);
+        size_t taken = count - chunk->flushed;
+        if (log_pending_count + taken > log_pending_capacity)
+        {
+            size_t capacity = log_pending_capacity > 0 ? log_pending_capacity : LOG_CHUNK_RECORDS;
+            while (capacity < log_pending_count + taken)
+                capacity *= 2;
+            log_pending = (LogRecord *)realloc(log_pending, capacity * sizeof(LogRecord));
+            if (log_pending == NULL)
+            {
+                perror("Failed to grow log buffer");
+                exit(EXIT_FAILURE);
+            }
+            log_pending_capacity = capacity;
+        }
+        memcpy(log_pending + log_pending_count, chunk->records + chunk->flushed, taken * sizeof(LogRecord));
+        log_pending_count += taken;
+        chunk->flushed = count;
+        if (retired || all)
+        {
+            *link = chunk->next;
+            if (retired || chunk == log_current ||
+                atomic_exchange_explicit(&chunk->retired, LOG_CHUNK_ABANDONED, memory_order_acq_rel) == LOG_CHUNK_RETIRED)
+                free(chunk);
+        }
+        else
+            link = &chunk->next;
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Formats the pending records up to watermark in time order and writes them to fd in
+// LOG_OUTPUT_SIZE batches; younger ones stay pending for the next pass
+static void log_write_pending(int fd, LogFormatter format, uint64_t watermark)
+{
+    if (log_pending_count == 0)
+        return;
+    qsort(log_pending, log_pending_count, sizeof(LogRecord), log_compare);
+    size_t ready = 0;
+    while (ready < log_pending_count && log_pending[ready].timeNs <= watermark)
+        ready++;
+    if (ready == 0)
+        return;
+
+    char *output = (char *)malloc(LOG_OUTPUT_SIZE);
+    if (output == NULL)
+    {
+        perror("Failed to allocate log output");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < ready; i++)
+    {
+        if (used + LOG_LINE_SIZE > LOG_OUTPUT_SIZE)
+        {
+            log_write(fd, output, used);
+            used = 0;
+        }
+        int length = format(&log_pending[i], output + used, LOG_LINE_SIZE);
+        if (length > 0)
+            used += length < LOG_LINE_SIZE ? length : LOG_LINE_SIZE - 1;
+    }
+    log_write(fd, output, used);
+    free(output);
+    memmove(log_pending, log_pending + ready, (log_pending_count - ready) * sizeof(LogRecord));
+    log_pending_count -= ready;
+}
+
+static void *log_flusher_main(void *arg)
+{
+    pthread_mutex_lock(&log_lock);
+    while (!log_flusher_stop)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += LOG_FLUSH_INTERVAL_NS;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&log_flusher_wake, &log_lock, &deadline);
+        if (log_flusher_stop)
+            break;
+        pthread_mutex_unlock(&log_lock);
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t nowNs = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+        log_collect(0);
+        log_write_pending(log_fd, log_format, nowNs > LOG_MERGE_WINDOW_NS ? nowNs - LOG_MERGE_WINDOW_NS : 0);
+        pthread_mutex_lock(&log_lock);
+    }
+    pthread_mutex_unlock(&log_lock);
+    return NULL;
+}
+
+// Starts the flusher thread, which writes records to fd in time order once they are
+// LOG_MERGE_WINDOW_NS old, so a thread that is slow to publish cannot reorder the output
+// beyond that window
+void log_start(int fd, LogFormatter format)
+{
+    log_fd = fd;
+    log_format = format;
+    log_flusher_stop = 0;
+    if (pthread_create(&log_flusher, NULL, log_flusher_main, NULL) != 0)
+    {
+        perror("Failed to start log flusher");
+        exit(EXIT_FAILURE);
+    }
+    log_flusher_running = 1;
+}
+
+// Stops the flusher and writes the tail: every record still buffered, in time order. Only call
+// once no other thread of the process is logging.
+void log_flush(int fd, LogFormatter format)
+{
+    if (log_flusher_running)
+    {
+        pthread_mutex_lock(&log_lock);
+        log_flusher_stop = 1;
+        pthread_cond_signal(&log_flusher_wake);
+        pthread_mutex_unlock(&log_lock);
+        pthread_join(log_flusher, NULL);
+        log_flusher_running = 0;
+    }
+    log_collect(1);
+    if (log_current != NULL)
+        pthread_setspecific(log_key, NULL); // freed above, so this thread's exit must not retire it
+    log_current = NULL;
+    log_write_pending(fd, format, UINT64_MAX);
+    free(log_pending);
+    log_pending = NULL;
+    log_pending_capacity = 0;
+}
+
+// A forked child starts with a copy of the parent's unflushed records and no flusher thread;
+// drop the records so they are not written twice
+void log_reset_after_fork()
+{
+    pthread_mutex_init(&log_lock, NULL);
+    pthread_cond_init(&log_flusher_wake, NULL);
+    while (log_chunks != NULL)
+    {
+        LogChunk *next = log_chunks->next;
+        free(log_chunks);
+        log_chunks = next;
+    }
+    free(log_pending);
+    log_pending = NULL;
+    log_pending_count = 0;
+    log_pending_capacity = 0;
+    log_flusher_running = 0;
+    log_current = NULL;
+    log_threads = 0;
+    log_thread = -1;
+    log_seq = 0;
+}
+
+#endif
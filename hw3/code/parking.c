@@ -9,167 +9,1238 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 #include "parking_utils.h"
+#include "des_utils.h"
+#include "log_utils.h"
 
 #define NUM_VEHICLES 50
+#define DEFAULT_BENCH_ITERATIONS 1000000
+#define ARRIVAL_DELAY_US 100000
+#define ATTENDANT_DELAY_US 500000
+#define DEPARTURE_TICK_US 1000
+#define USAGE "Usage: %s [-c atomic|sem|mutex] [-m thread|pool|process [-K]] [-w workers] [-A attendants] [-n vehicles] [-a arrival_us] [-d attendant_us] [-q]\n" \
+              "           [-W queue_slots [-P patience_us]] [-D [-t stay_us]] [-z automobile_spots,pickup_spots]\n" \
+              "       %s -C [-w workers] [-A attendants] [-n vehicles] [-a arrival_us] [-d attendant_us]\n" \
+              "       %s -S max_attendants [-m thread|pool|process] [-w workers] [-n vehicles] [-a arrival_us] [-d attendant_us]\n" \
+              "       %s -E [-s seed] [-n vehicles] [-a arrival_us] [-d attendant_us] [-t stay_us]\n" \
+              "       %s -b threads [-i iterations]\n" \
+              "       (all threaded modes also take [-L lots] [-R hash|least|nearest])\n"
 
-sem_t *newPickup;
-sem_t *inChargeforPickup;
-sem_t *newAutomobile;
-sem_t *inChargeforAutomobile;
-sem_t *pickupCounterControl;
-sem_t *automobileCounterControl;
+typedef enum
+{
+    COUNTER_ATOMIC,   // CAS on the shared counters, no lock
+    COUNTER_SEMAPHORE, // original scheme: the lot's counter semaphore around every update
+    COUNTER_MUTEX      // the lot's robust process-shared mutex around every update
+} CounterMode;
+
+typedef enum
+{
+    EXECUTION_THREAD_PER_VEHICLE, // original scheme: one pthread per arrival
+    EXECUTION_POOL,               // arrivals are tasks served by a fixed set of workers
+    EXECUTION_PROCESS             // attendants and owner generators are separate processes on the segment
+} ExecutionMode;
 
-ParkingLot *parkingLot;
+ParkingSegment *segment;
+ParkingLot *parkingLots;
+int lotCount = 1;
+RoutePolicy routePolicy = ROUTE_HASH;
+CounterMode counterMode = COUNTER_ATOMIC;
+ExecutionMode executionMode = EXECUTION_THREAD_PER_VEHICLE;
+int poolWorkers = 0;
+int attendantsPerType = 1;
+int waitCapacity = 0; // 0 turns owners away from a full lot instead of queueing them
+int patience = 0;     // microseconds a queued owner waits before leaving, 0 waits indefinitely
+int spotCapacity[2] = {MAX_AUTOMOBILES, MAX_PICKUPS};
+int departuresEnabled = 0; // parked vehicles stay [0, stayTime) us instead of freeing their spot at once
+int vehicleCount = NUM_VEHICLES;
+int arrivalDelay = ARRIVAL_DELAY_US;
+int attendantDelay = ATTENDANT_DELAY_US;
+int verbose = 1;
+uint64_t seed = 0;
+int seedGiven = 0;
+int stayTime = DEFAULT_STAY_US;
+int crashOwner = 0;
+TaskQueue arrivals;
+atomic_int liveOwners;
+int peakOwners;
 
+void openResources();
+void closeResources();
+void logEvent(LogEventType type, int vehicleType, int lot, int spot, int count, long value);
+int formatLogRecord(const LogRecord *record, char *line, size_t size);
+void startEventLog();
+void flushEventLog();
+void parkVehicle(const Vehicle *vehicle);
+int routeVehicle(const Vehicle *vehicle, int *remaining);
+int waitForSpot(const Vehicle *vehicle, int *remaining, long *waitedUs);
+int returnSpot(ParkingLot *lot, int vehicleType);
+void printWaitStats();
+int allocateSpot(ParkingLot *lot, int vehicleType);
+void printSpotStats();
+void scheduleDeparture(int lot, int vehicleType, int spot, int stay);
+void *departureTicker(void *arg);
+void printDepartureStats();
 void *carOwner(void *arg);
+void *poolWorker(void *arg);
 void *carAttendant(void *arg);
 void parkingSimulation();
+void processSimulation(double *seconds);
+void stopAttendants();
+void printAttendantStats(double seconds);
+void attendantSweep(int maxAttendants);
+void attachMember();
+void compareExecutionModes();
+void eventSimulation();
+int reserveSpot(ParkingLot *lot, int vehicleType, int *remaining);
+int releaseSpot(ParkingLot *lot, int vehicleType);
+void *counterBenchWorker(void *arg);
+void counterBenchmark(int threadCount, long iterations);
 
-volatile int stopFlag = 0;
-
-int main()
+int main(int argc, char *argv[])
 {
+    int benchThreads = 0;
+    long benchIterations = DEFAULT_BENCH_ITERATIONS;
+    int compareModes = 0;
+    int eventDriven = 0;
+    int sweepAttendants = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:b:i:m:w:n:a:d:qCEs:t:L:R:KA:S:W:P:Dz:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'A':
+            attendantsPerType = atoi(optarg);
+            if (attendantsPerType <= 0 || attendantsPerType > MAX_ATTENDANTS)
+            {
+                printf("Invalid number of attendants. Please enter a value between 1 and %d.\n", MAX_ATTENDANTS);
+                return 1;
+            }
+            break;
+        case 'D':
+            departuresEnabled = 1;
+            break;
+        case 'z':
+            if (sscanf(optarg, "%d,%d", &spotCapacity[0], &spotCapacity[1]) != 2 || spotCapacity[0] <= 0 || spotCapacity[1] <= 0 ||
+                spotCapacity[0] > MAX_SPOTS || spotCapacity[1] > MAX_SPOTS)
+            {
+                printf("Invalid lot size '%s'. Use automobile_spots,pickup_spots, each between 1 and %d.\n", optarg, MAX_SPOTS);
+                return 1;
+            }
+            break;
+        case 'W':
+            waitCapacity = atoi(optarg);
+            if (waitCapacity < 0 || waitCapacity > WAIT_QUEUE_SLOTS)
+            {
+                printf("Invalid wait queue size. Please enter a value between 0 and %d.\n", WAIT_QUEUE_SLOTS);
+                return 1;
+            }
+            break;
+        case 'P':
+            patience = atoi(optarg);
+            if (patience < 0)
+            {
+                printf("Invalid patience. Please enter a non-negative integer.\n");
+                return 1;
+            }
+            break;
+        case 'S':
+            sweepAttendants = atoi(optarg);
+            if (sweepAttendants <= 0 || sweepAttendants > MAX_ATTENDANTS)
+            {
+                printf("Invalid number of attendants. Please enter a value between 1 and %d.\n", MAX_ATTENDANTS);
+                return 1;
+            }
+            break;
+        case 'E':
+            eventDriven = 1;
+            break;
+        case 'L':
+            lotCount = atoi(optarg);
+            if (lotCount <= 0 || lotCount > MAX_LOTS)
+            {
+                printf("Invalid number of lots. Please enter a value between 1 and %d.\n", MAX_LOTS);
+                return 1;
+            }
+            break;
+        case 'R':
+            if (parse_route_policy(optarg) == -1)
+            {
+                printf("Invalid routing policy '%s'. Use 'hash', 'least' or 'nearest'.\n", optarg);
+                return 1;
+            }
+            routePolicy = (RoutePolicy)parse_route_policy(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            seedGiven = 1;
+            break;
+        case 't':
+            stayTime = atoi(optarg);
+            if (stayTime < 0)
+            {
+                printf("Invalid stay time. Please enter a non-negative integer.\n");
+                return 1;
+            }
+            break;
+        case 'm':
+            if (strcmp(optarg, "thread") == 0)
+                executionMode = EXECUTION_THREAD_PER_VEHICLE;
+            else if (strcmp(optarg, "pool") == 0)
+                executionMode = EXECUTION_POOL;
+            else if (strcmp(optarg, "process") == 0)
+                executionMode = EXECUTION_PROCESS;
+            else
+            {
+                printf("Invalid execution mode '%s'. Use 'thread', 'pool' or 'process'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':
+            poolWorkers = atoi(optarg);
+            if (poolWorkers <= 0)
+            {
+                printf("Invalid number of workers. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        case 'n':
+            vehicleCount = atoi(optarg);
+            if (vehicleCount <= 0)
+            {
+                printf("Invalid number of vehicles. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        case 'a':
+            arrivalDelay = atoi(optarg);
+            if (arrivalDelay < 0)
+            {
+                printf("Invalid arrival delay. Please enter a non-negative integer.\n");
+                return 1;
+            }
+            break;
+        case 'd':
+            attendantDelay = atoi(optarg);
+            if (attendantDelay < 0)
+            {
+                printf("Invalid attendant delay. Please enter a non-negative integer.\n");
+                return 1;
+            }
+            break;
+        case 'q':
+            verbose = 0;
+            break;
+        case 'C':
+            compareModes = 1;
+            break;
+        case 'K':
+            crashOwner = 1;
+            break;
+        case 'c':
+            if (strcmp(optarg, "atomic") == 0)
+                counterMode = COUNTER_ATOMIC;
+            else if (strcmp(optarg, "sem") == 0)
+                counterMode = COUNTER_SEMAPHORE;
+            else if (strcmp(optarg, "mutex") == 0)
+                counterMode = COUNTER_MUTEX;
+            else
+            {
+                printf("Invalid counter mode '%s'. Use 'atomic', 'sem' or 'mutex'.\n", optarg);
+                return 1;
+            }
+            break;
+        case 'b':
+            benchThreads = atoi(optarg);
+            if (benchThreads <= 0)
+            {
+                printf("Invalid number of benchmark threads. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        case 'i':
+            benchIterations = atol(optarg);
+            if (benchIterations <= 0)
+            {
+                printf("Invalid number of iterations. Please enter a positive integer.\n");
+                return 1;
+            }
+            break;
+        default:
+            printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 0)
+    {
+        printf(USAGE, argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+    if (crashOwner && executionMode != EXECUTION_PROCESS)
+    {
+        printf("-K only applies to '-m process'.\n");
+        return 1;
+    }
+    if (crashOwner)
+        counterMode = COUNTER_MUTEX; // the crash is injected while holding a lot mutex
+    if (poolWorkers == 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        poolWorkers = cores < 1 ? 1 : (int)cores;
+    }
     srand(time(NULL));
 
-    parkingLot = init_shared_memory(SHM_PARKING_LOT);
-    newPickup = init_semaphore(SEM_NEW_PICKUP, 0);
-    inChargeforPickup = init_semaphore(SEM_IN_CHARGE_PICKUP, 1);
-    newAutomobile = init_semaphore(SEM_NEW_AUTOMOBILE, 0);
-    inChargeforAutomobile = init_semaphore(SEM_IN_CHARGE_AUTOMOBILE, 1);
-    pickupCounterControl = init_semaphore(SEM_PICKUP_COUNTER_CONTROL, 1);
-    automobileCounterControl = init_semaphore(SEM_AUTOMOBILE_COUNTER_CONTROL, 1);
+    if (eventDriven)
+    {
+        eventSimulation();
+        return 0;
+    }
+    if (compareModes)
+    {
+        compareExecutionModes();
+        return 0;
+    }
+    if (sweepAttendants > 0)
+    {
+        attendantSweep(sweepAttendants);
+        return 0;
+    }
+
+    openResources();
+    if (benchThreads > 0)
+        counterBenchmark(benchThreads, benchIterations);
+    else
+        parkingSimulation();
+    closeResources();
+
+    return 0;
+}
+
+void openResources()
+{
+    segment = init_shared_memory(SHM_PARKING_LOT, lotCount, spotCapacity[0], spotCapacity[1]);
+    parkingLots = segment->lots;
+}
 
-    parkingSimulation();
+void closeResources()
+{
+    free_shared_memory(segment, SHM_PARKING_LOT);
+}
 
-    free_shared_memory(parkingLot, SHM_PARKING_LOT);
-    free_semaphore(newPickup, SEM_NEW_PICKUP);
-    free_semaphore(inChargeforPickup, SEM_IN_CHARGE_PICKUP);
-    free_semaphore(newAutomobile, SEM_NEW_AUTOMOBILE);
-    free_semaphore(inChargeforAutomobile, SEM_IN_CHARGE_AUTOMOBILE);
-    free_semaphore(pickupCounterControl, SEM_PICKUP_COUNTER_CONTROL);
-    free_semaphore(automobileCounterControl, SEM_AUTOMOBILE_COUNTER_CONTROL);
+// Run at the start of every forked member: attach to the segment by name like an independent
+// process would, and stop sharing the parent's rand() sequence
+void attachMember()
+{
+    segment = attach_shared_memory(SHM_PARKING_LOT);
+    parkingLots = segment->lots;
+    srand(time(NULL) ^ getpid());
+    log_reset_after_fork();
+    startEventLog();
+}
 
+// Records go to the calling thread's log buffer; a flusher thread formats and writes them in
+// batches while the run goes on, so the simulated threads never block on stdout
+void logEvent(LogEventType type, int vehicleType, int lot, int spot, int count, long value)
+{
+    if (verbose)
+        log_record(type, vehicleType, lot, spot, count, value);
+}
+
+void startEventLog()
+{
+    if (verbose)
+        log_start(STDOUT_FILENO, formatLogRecord);
+}
+
+// Writes what the flusher has not yet written
+void flushEventLog()
+{
+    if (verbose)
+        log_flush(STDOUT_FILENO, formatLogRecord);
+}
+
+// Renders a record as the line the simulation used to print directly
+int formatLogRecord(const LogRecord *record, char *line, size_t size)
+{
+    const char *name = record->vehicleType == 0 ? "an automobile" : "a pickup";
+    const char *title = record->vehicleType == 0 ? "Automobile" : "Pickup";
+    switch (record->type)
+    {
+    case LOG_OWNER_ATTEMPT:
+        return snprintf(line, size, "Car Owner: Attempting to park %s.\n", name);
+    case LOG_OWNER_FOUND:
+        if (lotCount > 1)
+            return snprintf(line, size, "Car Owner: Found a spot for %s in lot %d. Remaining: %d\n", name, record->lot, record->count);
+        return snprintf(line, size, "Car Owner: Found a spot for %s. Remaining: %d\n", name, record->count);
+    case LOG_OWNER_PARKED:
+        return snprintf(line, size, "Car Owner: Parked %s successfully.\n", name);
+    case LOG_OWNER_NO_SPACE:
+        return snprintf(line, size, "Car Owner: No space for %s, leaving.\n", name);
+    case LOG_OWNER_NO_ROOM:
+        return snprintf(line, size, "Car Owner: No space and no room to wait for %s, leaving.\n", name);
+    case LOG_OWNER_WAITING:
+        return snprintf(line, size, "Car Owner: Lot full, waiting for a spot for %s.\n", name);
+    case LOG_OWNER_GAVE_UP:
+        return snprintf(line, size, "Car Owner: Gave up waiting for %s after %lld us, leaving.\n", name, (long long)record->value);
+    case LOG_ATTENDANT_PARKED:
+        if (lotCount > 1)
+            return snprintf(line, size, "Car Attendant: %s parked in lot %d, spot %d. Available spaces now: %d\n", title, record->lot,
+                            record->spot, record->count);
+        return snprintf(line, size, "Car Attendant: %s parked in spot %d. Available spaces now: %d\n", title, record->spot, record->count);
+    case LOG_ATTENDANT_STAYING:
+        return snprintf(line, size, "Car Attendant: %s parked in lot %d, spot %d, staying %lld ms. Available spaces now: %d\n", title,
+                        record->lot, record->spot, (long long)record->value / 1000, record->count);
+    case LOG_DEPARTURE:
+        return snprintf(line, size, "Departure: %s left lot %d, spot %d. Available spaces now: %d\n", title, record->lot, record->spot,
+                        record->count);
+    }
     return 0;
 }
 
 void parkingSimulation()
 {
-    pthread_t threads[NUM_VEHICLES + 2];
-    pthread_create(&threads[0], NULL, carAttendant, (void *)"automobile");
-    pthread_create(&threads[1], NULL, carAttendant, (void *)"pickup");
-
-    for (int i = 0; i < NUM_VEHICLES; i++)
+    char buffer[BUFFER_SIZE];
+    if (executionMode == EXECUTION_PROCESS)
     {
-        int *vehicleType = (int *)malloc(sizeof(int));
-        *vehicleType = rand() % 2; // 0 for automobile, 1 for pickup
-        pthread_create(&threads[2 + i], NULL, carOwner, (void *)vehicleType);
-        usleep(rand() % 100000);
+        double seconds;
+        processSimulation(&seconds);
+        snprintf(buffer, BUFFER_SIZE, "Processes: %d vehicles over %d lot(s) (%s) in %.3f ms (%.0f vehicles/s), %d owner processes, "
+                 "%d attendant processes, %ld robust lock recoveries\n", vehicleCount, lotCount, route_names[routePolicy],
+                 seconds * 1e3, vehicleCount / seconds, poolWorkers, 2 * lotCount * attendantsPerType,
+                 atomic_load(&segment->header.recovered));
+        print(buffer);
+        printAttendantStats(seconds);
+        printWaitStats();
+        printDepartureStats();
+        printSpotStats();
+        return;
     }
+    // attendantsPerType attendants per vehicle type in every lot; the argument encodes
+    // (lot * 2 + vehicle type) * attendantsPerType + attendant
+    int attendantTotal = 2 * lotCount * attendantsPerType;
+    pthread_t *attendants = (pthread_t *)malloc(attendantTotal * sizeof(pthread_t));
+    if (attendants == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    startEventLog();
+    for (long i = 0; i < attendantTotal; i++)
+        pthread_create(&attendants[i], NULL, carAttendant, (void *)i);
+    pthread_t ticker;
+    if (departuresEnabled)
+        pthread_create(&ticker, NULL, departureTicker, NULL);
 
-    for (int i = 2; i < NUM_VEHICLES + 2; i++)
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    atomic_init(&liveOwners, 0);
+    peakOwners = 0;
+    int failed = 0;
+    if (executionMode == EXECUTION_THREAD_PER_VEHICLE)
     {
-        pthread_join(threads[i], NULL);
+        // Detached, so a finished owner gives its stack back right away instead of waiting to be joined
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        for (int i = 0; i < vehicleCount; i++)
+        {
+            Vehicle *vehicle = (Vehicle *)malloc(sizeof(Vehicle));
+            vehicle->id = i;
+            vehicle->vehicleType = rand() % 2; // 0 for automobile, 1 for pickup
+            int live = atomic_fetch_add(&liveOwners, 1) + 1;
+            if (live > peakOwners)
+                peakOwners = live;
+            pthread_t thread;
+            if (pthread_create(&thread, &attr, carOwner, (void *)vehicle) != 0)
+            {
+                // Out of threads or stack memory: the arrival is lost, which is the cost being measured
+                atomic_fetch_sub(&liveOwners, 1);
+                free(vehicle);
+                failed++;
+            }
+            if (arrivalDelay > 0)
+                usleep(rand() % arrivalDelay);
+        }
+        pthread_attr_destroy(&attr);
+        while (atomic_load(&liveOwners) > 0)
+            usleep(1000);
     }
+    else
+    {
+        pthread_t *workers = (pthread_t *)malloc(poolWorkers * sizeof(pthread_t));
+        if (workers == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        task_queue_init(&arrivals);
+        for (int i = 0; i < poolWorkers; i++)
+            pthread_create(&workers[i], NULL, poolWorker, NULL);
+        peakOwners = poolWorkers;
+        for (int i = 0; i < vehicleCount; i++)
+        {
+            Vehicle vehicle = {i, rand() % 2}; // 0 for automobile, 1 for pickup
+            task_queue_push(&arrivals, vehicle);
+            if (arrivalDelay > 0)
+                usleep(rand() % arrivalDelay);
+        }
+        task_queue_close(&arrivals);
+        for (int i = 0; i < poolWorkers; i++)
+            pthread_join(workers[i], NULL);
+        task_queue_destroy(&arrivals);
+        free(workers);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
-    stopFlag = 1; 
+    stopAttendants();
+    for (int i = 0; i < attendantTotal; i++)
+        pthread_join(attendants[i], NULL);
+    free(attendants);
+    if (departuresEnabled)
+        pthread_join(ticker, NULL);
+    flushEventLog();
 
-    sem_post(newAutomobile);
-    sem_post(newPickup);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    snprintf(buffer, BUFFER_SIZE, "%s: %d vehicles over %d lot(s) (%s) in %.3f ms (%.0f vehicles/s), peak %d owner threads, %d failed to start\n",
+             executionMode == EXECUTION_POOL ? "Worker pool" : "Thread per vehicle", vehicleCount, lotCount, route_names[routePolicy],
+             seconds * 1e3, vehicleCount / seconds, peakOwners, failed);
+    print(buffer);
+    printAttendantStats(seconds);
+    printWaitStats();
+    printDepartureStats();
+    printSpotStats();
+}
 
-    pthread_join(threads[0], NULL);
-    pthread_join(threads[1], NULL);
+void stopAttendants()
+{
+    atomic_store(&segment->header.stop, 1);
+    for (int i = 0; i < lotCount; i++)
+    {
+        ring_wake(&parkingLots[i].automobileHandoff.pending, INT_MAX);
+        ring_wake(&parkingLots[i].pickupHandoff.pending, INT_MAX);
+    }
 }
 
-void *carOwner(void *arg)
+// Utilization is the share of the run an attendant spent parking; one line per vehicle type,
+// plus one per attendant in verbose mode
+void printAttendantStats(double seconds)
 {
     char buffer[BUFFER_SIZE];
-    int vehicleType = *(int *)arg;
-    free(arg);
-
-    if (vehicleType == 0)
+    const char *names[] = {"Automobile", "Pickup"};
+    for (int type = 0; type < 2; type++)
     {
-        sem_wait(automobileCounterControl);
-        snprintf(buffer, BUFFER_SIZE, "Car Owner: Attempting to park an automobile.\n");
+        long served = 0, handoffNs = 0, maxHandoffNs = 0;
+        double sum = 0, low = 1, high = 0;
+        for (int lot = 0; lot < lotCount; lot++)
+            for (int k = 0; k < attendantsPerType; k++)
+            {
+                AttendantStats *stats = &lot_handoff(&parkingLots[lot], type)->attendants[k];
+                double utilization = stats->busyNs / (seconds * 1e9);
+                served += stats->served;
+                handoffNs += stats->handoffNs;
+                if (stats->maxHandoffNs > maxHandoffNs)
+                    maxHandoffNs = stats->maxHandoffNs;
+                sum += utilization;
+                if (utilization < low)
+                    low = utilization;
+                if (utilization > high)
+                    high = utilization;
+                if (verbose)
+                {
+                    snprintf(buffer, BUFFER_SIZE, "    %s attendant %d in lot %d: %ld served, %.1f%% busy\n", names[type], k, lot,
+                             stats->served, utilization * 100);
+                    print(buffer);
+                }
+            }
+        snprintf(buffer, BUFFER_SIZE,
+                 "  %s attendants: %d per lot, %ld served, utilization mean %.1f%% (min %.1f%%, max %.1f%%), hand-off mean %.1f us (max %.1f us)\n",
+                 names[type], attendantsPerType, served, sum / (lotCount * attendantsPerType) * 100, low * 100, high * 100,
+                 served > 0 ? handoffNs / 1e3 / served : 0.0, maxHandoffNs / 1e3);
         print(buffer);
-        if (parkingLot->mFree_automobile > 0)
+    }
+}
+
+// Same workload for 1..maxAttendants attendants per vehicle type, each on a fresh segment
+void attendantSweep(int maxAttendants)
+{
+    char buffer[BUFFER_SIZE];
+    snprintf(buffer, BUFFER_SIZE, "Attendant sweep: %d vehicles, attendant delay %d us, arrival delay %d us\n", vehicleCount,
+             attendantDelay, arrivalDelay);
+    print(buffer);
+    verbose = 0;
+    for (attendantsPerType = 1; attendantsPerType <= maxAttendants; attendantsPerType++)
+    {
+        openResources();
+        parkingSimulation();
+        closeResources();
+    }
+}
+
+void *carOwner(void *arg)
+{
+    Vehicle *vehicle = (Vehicle *)arg;
+    parkVehicle(vehicle);
+    free(vehicle);
+    atomic_fetch_sub(&liveOwners, 1);
+    return NULL;
+}
+
+void *poolWorker(void *arg)
+{
+    Vehicle vehicle;
+    while (task_queue_pop(&arrivals, &vehicle))
+        parkVehicle(&vehicle);
+    return NULL;
+}
+
+void parkVehicle(const Vehicle *vehicle)
+{
+    int type = vehicle->vehicleType;
+    int remaining;
+    long waitedUs = 0;
+
+    logEvent(LOG_OWNER_ATTEMPT, type, -1, -1, 0, 0);
+    int lot = routeVehicle(vehicle, &remaining);
+    if (lot < 0 && waitCapacity > 0)
+        lot = waitForSpot(vehicle, &remaining, &waitedUs);
+    if (lot >= 0)
+    {
+        wait_stats_record(&segment->header.waitStats, waitedUs);
+        logEvent(LOG_OWNER_FOUND, type, lot, -1, remaining, 0);
+        handoff_vehicle(lot_handoff(&parkingLots[lot], type), vehicle->id);
+        logEvent(LOG_OWNER_PARKED, type, lot, -1, 0, 0);
+    }
+    else if (waitCapacity == 0)
+        logEvent(LOG_OWNER_NO_SPACE, type, -1, -1, 0, 0);
+}
+
+// Queues the owner at its home lot until a released spot is handed over or its patience runs
+// out; returns the lot, or -1 when the wait queue was full or the owner gave up
+int waitForSpot(const Vehicle *vehicle, int *remaining, long *waitedUs)
+{
+    int lot = lotCount == 1 ? 0 : home_lot(vehicle->id, lotCount);
+    ParkingLot *parkingLot = &parkingLots[lot];
+    WaitQueue *queue = lot_wait_queue(parkingLot, vehicle->vehicleType);
+    WaitStats *stats = &segment->header.waitStats;
+
+    // Releases also run under the queue lock, so a spot freed since routing is seen here and
+    // cannot slip past a waiter that is about to be queued
+    lock_robust(&queue->lock, &segment->header.recovered, wait_queue_repair, queue);
+    if (reserveSpot(parkingLot, vehicle->vehicleType, remaining))
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return lot;
+    }
+    int slot = wait_queue_enqueue(queue, waitCapacity);
+    pthread_mutex_unlock(&queue->lock);
+    if (slot == -1)
+    {
+        atomic_fetch_add(&stats->balked, 1);
+        logEvent(LOG_OWNER_NO_ROOM, vehicle->vehicleType, lot, -1, 0, 0);
+        return -1;
+    }
+    atomic_fetch_add(&stats->queued, 1);
+    logEvent(LOG_OWNER_WAITING, vehicle->vehicleType, lot, -1, 0, 0);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sem_t *wake = &queue->waiters[slot].wake;
+    int rc;
+    if (patience > 0)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += patience / 1000000;
+        deadline.tv_nsec += (patience % 1000000) * 1000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while ((rc = sem_timedwait(wake, &deadline)) == -1 && errno == EINTR)
+            ;
+    }
+    else
+    {
+        while ((rc = sem_wait(wake)) == -1 && errno == EINTR)
+            ;
+    }
+
+    int granted = rc == 0;
+    lock_robust(&queue->lock, &segment->header.recovered, wait_queue_repair, queue);
+    if (!granted)
+    {
+        if (queue->waiters[slot].state == WAITER_GRANTED)
         {
-            parkingLot->mFree_automobile--;
-            sem_post(automobileCounterControl);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: Found a spot for an automobile. Remaining: %d\n", parkingLot->mFree_automobile);
-            print(buffer);
-            sem_post(newAutomobile);
-            sem_wait(inChargeforAutomobile);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: Parked an automobile successfully.\n");
-            print(buffer);
+            // The spot was handed over just as patience ran out: take it
+            sem_wait(wake);
+            granted = 1;
         }
         else
+            wait_queue_remove(queue, slot);
+    }
+    queue->waiters[slot].state = WAITER_FREE;
+    pthread_mutex_unlock(&queue->lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *waitedUs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+
+    if (!granted)
+    {
+        atomic_fetch_add(&stats->abandoned, 1);
+        logEvent(LOG_OWNER_GAVE_UP, vehicle->vehicleType, lot, -1, 0, *waitedUs);
+        return -1;
+    }
+    *remaining = atomic_load(lot_counter(parkingLot, vehicle->vehicleType));
+    return lot;
+}
+
+// A freed spot goes to the oldest waiter when the wait queue is on, otherwise back to the counter
+int returnSpot(ParkingLot *lot, int vehicleType)
+{
+    if (waitCapacity == 0)
+        return releaseSpot(lot, vehicleType);
+    WaitQueue *queue = lot_wait_queue(lot, vehicleType);
+    lock_robust(&queue->lock, &segment->header.recovered, wait_queue_repair, queue);
+    int available = wait_queue_grant(queue) ? 0 : releaseSpot(lot, vehicleType);
+    pthread_mutex_unlock(&queue->lock);
+    return available;
+}
+
+void printWaitStats()
+{
+    if (waitCapacity == 0)
+        return;
+    char buffer[BUFFER_SIZE];
+    WaitStats *stats = &segment->header.waitStats;
+    long queued = atomic_load(&stats->queued), abandoned = atomic_load(&stats->abandoned);
+    char limit[32] = "unlimited";
+    if (patience > 0)
+        snprintf(limit, sizeof(limit), "%d us", patience);
+    snprintf(buffer, BUFFER_SIZE, "  Waiting: %ld of %d vehicles queued (%d slots, patience %s), %ld abandoned (%.1f%% of queued, %.1f%% of arrivals), "
+             "%ld found the queue full\n", queued, vehicleCount, waitCapacity, limit, abandoned,
+             queued > 0 ? 100.0 * abandoned / queued : 0.0, 100.0 * abandoned / vehicleCount, atomic_load(&stats->balked));
+    print(buffer);
+    snprintf(buffer, BUFFER_SIZE, "  Queueing delay over %ld parked: p50 %ld us, p90 %ld us, p99 %ld us, max %ld us\n",
+             atomic_load(&stats->parked), wait_stats_percentile(stats, 0.5), wait_stats_percentile(stats, 0.9),
+             wait_stats_percentile(stats, 0.99), atomic_load(&stats->maxDelayUs));
+    print(buffer);
+}
+
+// Picks a lot under routePolicy and reserves a spot in it; returns the lot or -1 when turned away
+int routeVehicle(const Vehicle *vehicle, int *remaining)
+{
+    int type = vehicle->vehicleType;
+    if (routePolicy == ROUTE_HASH || lotCount == 1)
+    {
+        int lot = lotCount == 1 ? 0 : home_lot(vehicle->id, lotCount);
+        return reserveSpot(&parkingLots[lot], type, remaining) ? lot : -1;
+    }
+    if (routePolicy == ROUTE_NEAREST)
+    {
+        int home = home_lot(vehicle->id, lotCount);
+        for (int step = 0; step < lotCount; step++)
         {
-            sem_post(automobileCounterControl);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: No space for an automobile, leaving.\n");
-            print(buffer);
+            int lot = (home + step) % lotCount;
+            if (reserveSpot(&parkingLots[lot], type, remaining))
+                return lot;
         }
+        return -1;
     }
-    else
+
+    // Least loaded: the counts are read without locking, so a lot can fill between the scan and
+    // the reservation; rescan then, at most once per lot
+    for (int attempt = 0; attempt < lotCount; attempt++)
     {
-        sem_wait(pickupCounterControl);
-        snprintf(buffer, BUFFER_SIZE, "Car Owner: Attempting to park a pickup.\n");
-        print(buffer);
-        if (parkingLot->mFree_pickup > 0)
+        int best = -1, bestFree = 0;
+        for (int lot = 0; lot < lotCount; lot++)
         {
-            parkingLot->mFree_pickup--;
-            sem_post(pickupCounterControl);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: Found a spot for a pickup. Remaining: %d\n", parkingLot->mFree_pickup);
-            print(buffer);
-            sem_post(newPickup);
-            sem_wait(inChargeforPickup);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: Parked a pickup successfully.\n");
-            print(buffer);
+            int spots = atomic_load_explicit(lot_counter(&parkingLots[lot], type), memory_order_relaxed);
+            if (spots > bestFree)
+            {
+                best = lot;
+                bestFree = spots;
+            }
+        }
+        if (best == -1)
+            return -1;
+        if (reserveSpot(&parkingLots[best], type, remaining))
+            return best;
+    }
+    return -1;
+}
+
+void *carAttendant(void *arg)
+{
+    int attendant = (int)((long)arg % attendantsPerType);
+    int lot = (int)((long)arg / attendantsPerType / 2);
+    int vehicleType = (int)((long)arg / attendantsPerType % 2);
+    ParkingLot *parkingLot = &parkingLots[lot];
+    HandoffQueue *handoff = lot_handoff(parkingLot, vehicleType);
+    AttendantStats *stats = &handoff->attendants[attendant];
+    int ticket;
+    while ((ticket = handoff_take(handoff, &segment->header.stop)) != -1)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        long latency = (long)(monotonic_ns() - handoff->tickets[ticket].postedNs);
+        stats->handoffNs += latency;
+        if (latency > stats->maxHandoffNs)
+            stats->maxHandoffNs = latency;
+        if (attendantDelay > 0)
+            usleep(rand() % attendantDelay);
+        int spot = allocateSpot(parkingLot, vehicleType);
+        if (departuresEnabled)
+        {
+            int stay = stayTime > 0 ? rand() % stayTime : 0;
+            scheduleDeparture(lot, vehicleType, spot, stay);
+            logEvent(LOG_ATTENDANT_STAYING, vehicleType, lot, spot, atomic_load(lot_counter(parkingLot, vehicleType)), stay);
         }
         else
         {
-            sem_post(pickupCounterControl);
-            snprintf(buffer, BUFFER_SIZE, "Car Owner: No space for a pickup, leaving.\n");
-            print(buffer);
+            spot_free(lot_spots(parkingLot, vehicleType), spot);
+            logEvent(LOG_ATTENDANT_PARKED, vehicleType, lot, spot, returnSpot(parkingLot, vehicleType), 0);
         }
+        handoff_complete(handoff, ticket);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        stats->served++;
+        stats->busyNs += (end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec);
     }
+
     return NULL;
 }
 
-void *carAttendant(void *arg)
+// The owner already holds a reservation, so a free bit exists; a miss only means a concurrent
+// free landed behind the scan
+int allocateSpot(ParkingLot *lot, int vehicleType)
+{
+    int spot;
+    while ((spot = spot_alloc(lot_spots(lot, vehicleType))) == -1)
+        ;
+    return spot;
+}
+
+void printSpotStats()
 {
     char buffer[BUFFER_SIZE];
-    char *vehicleType = (char *)arg;
-    while (!stopFlag)
+    const char *names[] = {"automobiles", "pickups"};
+    int taken[2] = {0, 0}, highest[2] = {-1, -1};
+    for (int lot = 0; lot < lotCount; lot++)
+        for (int type = 0; type < 2; type++)
+        {
+            SpotBitmap *map = lot_spots(&parkingLots[lot], type);
+            taken[type] += spot_bitmap_used(map);
+            if (atomic_load(&map->highest) > highest[type])
+                highest[type] = atomic_load(&map->highest);
+        }
+    snprintf(buffer, BUFFER_SIZE, "  Spots: %s %d per lot, %d taken, highest used %d; %s %d per lot, %d taken, highest used %d\n", names[0],
+             spotCapacity[0], taken[0], highest[0], names[1], spotCapacity[1], taken[1], highest[1]);
+    print(buffer);
+}
+
+// The vehicle keeps its spot until the departure ticker reaches the end of its stay
+void scheduleDeparture(int lot, int vehicleType, int spot, int stay)
+{
+    DepartureBoard *board = &segment->header.departures;
+    TimerWheel *wheel = segment_wheel(segment);
+    lock_robust(&board->lock, &segment->header.recovered, departure_board_repair, segment);
+    // Never full while every node stands for a spot that is still taken: the ticker releases a
+    // firing batch before it hands any of those spots back
+    if (timer_wheel_schedule(wheel, (uint64_t)stay / DEPARTURE_TICK_US, (spot * lotCount + lot) * 2 + vehicleType) == WHEEL_NIL)
+    {
+        fprintf(stderr, "Departure wheel full: no node for lot %d spot %d\n", lot, spot);
+        exit(EXIT_FAILURE);
+    }
+    if (wheel->pending > board->peakParked)
+        board->peakParked = wheel->pending;
+    pthread_mutex_unlock(&board->lock);
+}
+
+// Keeps the wheel in step with the clock, one tick per DEPARTURE_TICK_US, and gives the spots of
+// departing vehicles back (to a waiting owner first, when the wait queue is on). Each batch is
+// copied out and its nodes released before any spot is returned, so a vehicle parking in a freed
+// spot always finds a node; the spots themselves go back outside the wheel lock.
+void *departureTicker(void *arg)
+{
+    DepartureBoard *board = &segment->header.departures;
+    TimerWheel *wheel = segment_wheel(segment);
+    int *payloads = (int *)malloc(wheel->capacity * sizeof(int));
+    if (payloads == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    struct timespec start, next;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
+    uint64_t ticks = 0;
+    while (!atomic_load(&segment->header.stop))
     {
-        if (strcmp(vehicleType, "automobile") == 0)
+        next.tv_nsec += DEPARTURE_TICK_US * 1000L;
+        if (next.tv_nsec >= 1000000000L)
         {
-            sem_wait(newAutomobile);
-            if (stopFlag)
-                break;
-            sem_wait(automobileCounterControl);
-            parkingLot->mFree_automobile++;
-            snprintf(buffer, BUFFER_SIZE, "Car Attendant: Automobile parked. Available spaces now: %d\n", parkingLot->mFree_automobile);
-            print(buffer);
-            sem_post(automobileCounterControl);
-            sem_post(inChargeforAutomobile);
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
         }
-        else if (strcmp(vehicleType, "pickup") == 0)
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        // Catch up on ticks lost to oversleeping, so stays do not stretch under load
+        uint64_t due = ((now.tv_sec - start.tv_sec) * 1000000000ULL + now.tv_nsec - start.tv_nsec) / (DEPARTURE_TICK_US * 1000ULL);
+        for (; ticks < due; ticks++)
         {
-            sem_wait(newPickup);
-            if (stopFlag)
-                break;
-            sem_wait(pickupCounterControl);
-            parkingLot->mFree_pickup++;
-            snprintf(buffer, BUFFER_SIZE, "Car Attendant: Pickup parked. Available spaces now: %d\n", parkingLot->mFree_pickup);
-            print(buffer);
-            sem_post(pickupCounterControl);
-            sem_post(inChargeforPickup);
+            int tail, departed = 0;
+            lock_robust(&board->lock, &segment->header.recovered, departure_board_repair, segment);
+            int head = timer_wheel_advance(wheel, &tail);
+            for (int node = head; node != WHEEL_NIL; node = wheel->nodes[node].next)
+                payloads[departed++] = wheel->nodes[node].payload;
+            timer_wheel_release(wheel, head, tail);
+            board->occupancySum += wheel->pending;
+            board->ticks++;
+            board->departed += departed;
+            pthread_mutex_unlock(&board->lock);
+
+            for (int i = 0; i < departed; i++)
+            {
+                int vehicleType = payloads[i] % 2, lot = payloads[i] / 2 % lotCount, spot = payloads[i] / 2 / lotCount;
+                spot_free(lot_spots(&parkingLots[lot], vehicleType), spot);
+                logEvent(LOG_DEPARTURE, vehicleType, lot, spot, returnSpot(&parkingLots[lot], vehicleType), 0);
+            }
         }
-        usleep(rand() % 500000);
     }
-    usleep(rand() % 500000);
+    free(payloads);
+    return NULL;
+}
+
+void printDepartureStats()
+{
+    if (!departuresEnabled)
+        return;
+    char buffer[BUFFER_SIZE];
+    DepartureBoard *board = &segment->header.departures;
+    snprintf(buffer, BUFFER_SIZE, "  Departures: %ld left, %ld still parked, peak %ld parked, mean %.2f parked over %ld ticks of %d us\n",
+             board->departed, segment_wheel(segment)->pending, board->peakParked,
+             board->ticks > 0 ? (double)board->occupancySum / board->ticks : 0.0, board->ticks, DEPARTURE_TICK_US);
+    print(buffer);
+}
+
+// Counter updates never print while holding a lock, so every mode only pays for the update itself
+int reserveSpot(ParkingLot *lot, int vehicleType, int *remaining)
+{
+    atomic_int *counter = lot_counter(lot, vehicleType);
+    if (counterMode == COUNTER_ATOMIC)
+        return reserve_spot(counter, remaining);
+
+    int reserved = 0;
+    if (counterMode == COUNTER_MUTEX)
+        lock_robust(lot_lock(lot, vehicleType), &segment->header.recovered, NULL, NULL);
+    else
+        sem_wait(lot_counter_control(lot, vehicleType));
+    int spots = atomic_load_explicit(counter, memory_order_relaxed);
+    if (spots > 0)
+    {
+        atomic_store_explicit(counter, spots - 1, memory_order_relaxed);
+        *remaining = spots - 1;
+        reserved = 1;
+    }
+    if (counterMode == COUNTER_MUTEX)
+        pthread_mutex_unlock(lot_lock(lot, vehicleType));
+    else
+        sem_post(lot_counter_control(lot, vehicleType));
+    return reserved;
+}
+
+int releaseSpot(ParkingLot *lot, int vehicleType)
+{
+    atomic_int *counter = lot_counter(lot, vehicleType);
+    if (counterMode == COUNTER_ATOMIC)
+        return release_spot(counter);
+
+    if (counterMode == COUNTER_MUTEX)
+        lock_robust(lot_lock(lot, vehicleType), &segment->header.recovered, NULL, NULL);
+    else
+        sem_wait(lot_counter_control(lot, vehicleType));
+    int available = atomic_load_explicit(counter, memory_order_relaxed) + 1;
+    atomic_store_explicit(counter, available, memory_order_relaxed);
+    if (counterMode == COUNTER_MUTEX)
+        pthread_mutex_unlock(lot_lock(lot, vehicleType));
+    else
+        sem_post(lot_counter_control(lot, vehicleType));
+    return available;
+}
+
+typedef struct
+{
+    int id;
+    long iterations;
+    long reserved;
+    int spots; // also take and free a concrete spot under each reservation
+} CounterBenchArgs;
 
+// Every thread routes automobiles to a lot and releases the spot again straight away
+void *counterBenchWorker(void *arg)
+{
+    CounterBenchArgs *args = (CounterBenchArgs *)arg;
+    int remaining;
+    for (long i = 0; i < args->iterations; i++)
+    {
+        Vehicle vehicle = {(int)(args->id * args->iterations + i), 0};
+        int lot = routeVehicle(&vehicle, &remaining);
+        if (lot >= 0)
+        {
+            args->reserved++;
+            if (args->spots)
+                spot_free(&parkingLots[lot].automobileSpots, allocateSpot(&parkingLots[lot], 0));
+            releaseSpot(&parkingLots[lot], 0);
+        }
+    }
     return NULL;
 }
+
+void counterBenchmark(int threadCount, long iterations)
+{
+    char buffer[BUFFER_SIZE];
+    pthread_t *threads = (pthread_t *)malloc(threadCount * sizeof(pthread_t));
+    CounterBenchArgs *args = (CounterBenchArgs *)calloc(threadCount, sizeof(CounterBenchArgs));
+    if (threads == NULL || args == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(buffer, BUFFER_SIZE, "Counter benchmark: %d threads x %ld reserve/release pairs over %d lot(s) (%s)\n", threadCount,
+             iterations, lotCount, route_names[routePolicy]);
+    print(buffer);
+    // The last round is the atomic counter again, with a spot taken from the bitmap each time
+    const char *names[] = {"atomic", "sem", "mutex", "bitmap"};
+    for (int mode = COUNTER_ATOMIC; mode <= COUNTER_MUTEX + 1; mode++)
+    {
+        counterMode = mode > COUNTER_MUTEX ? COUNTER_ATOMIC : (CounterMode)mode;
+        for (int lot = 0; lot < lotCount; lot++)
+            atomic_store(&parkingLots[lot].mFree_automobile, spotCapacity[0]);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < threadCount; i++)
+        {
+            args[i].id = i;
+            args[i].iterations = iterations;
+            args[i].reserved = 0;
+            args[i].spots = mode > COUNTER_MUTEX;
+            pthread_create(&threads[i], NULL, counterBenchWorker, &args[i]);
+        }
+        long reserved = 0;
+        for (int i = 0; i < threadCount; i++)
+        {
+            pthread_join(threads[i], NULL);
+            reserved += args[i].reserved;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        long operations = 2 * reserved + (threadCount * iterations - reserved); // failed reservations count once
+        int freeSpots = 0;
+        for (int lot = 0; lot < lotCount; lot++)
+            freeSpots += atomic_load(&parkingLots[lot].mFree_automobile) - spot_bitmap_used(&parkingLots[lot].automobileSpots);
+        snprintf(buffer, BUFFER_SIZE, "  %-6s %10.3f ms %10.1f ns/op %8.2f Mops/s  final free = %d\n", names[mode], seconds * 1e3,
+                 seconds * 1e9 / operations, operations / seconds / 1e6, freeSpots);
+        print(buffer);
+    }
+    free(threads);
+    free(args);
+}
+
+// Runs the same workload once per execution mode, each in a fresh child process, so the peak
+// RSS and CPU reported by wait4 belong to that mode alone (including its member processes)
+void compareExecutionModes()
+{
+    char buffer[BUFFER_SIZE];
+    ExecutionMode modes[] = {EXECUTION_THREAD_PER_VEHICLE, EXECUTION_POOL, EXECUTION_PROCESS};
+    verbose = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("Failed to fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0)
+        {
+            executionMode = modes[i];
+            openResources();
+            parkingSimulation();
+            closeResources();
+            exit(EXIT_SUCCESS);
+        }
+        int status;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) == -1)
+        {
+            perror("Failed to wait for child");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(buffer, BUFFER_SIZE, "  peak RSS %ld KiB, %.3f ms CPU, %ld context switches\n", usage.ru_maxrss,
+                 (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3,
+                 usage.ru_nvcsw + usage.ru_nivcsw);
+        print(buffer);
+    }
+}
+
+void eventSimulation()
+{
+    char buffer[BUFFER_SIZE];
+    if (!seedGiven)
+        seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    SimConfig config = {seed, vehicleCount, arrivalDelay, attendantDelay, stayTime};
+    SimStats stats;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    run_event_simulation(&config, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    long events = 0;
+    for (int i = 0; i < EVENT_TYPE_COUNT; i++)
+        events += stats.events[i];
+    const char *names[] = {"Automobiles", "Pickups"};
+    snprintf(buffer, BUFFER_SIZE, "Event simulation: %d vehicles, seed %llu, %.3f s of virtual time\n", vehicleCount,
+             (unsigned long long)seed, stats.endTime / 1e6);
+    print(buffer);
+    for (int i = 0; i < VEHICLE_TYPES; i++)
+    {
+        snprintf(buffer, BUFFER_SIZE, "  %-11s arrived %ld, parked %ld, no space %ld, departed %ld\n", names[i], stats.arrivals[i],
+                 stats.parked[i], stats.rejected[i], stats.departures[i]);
+        print(buffer);
+    }
+    snprintf(buffer, BUFFER_SIZE, "  %ld events (%ld arrival, %ld park-complete, %ld departure) in %.3f ms: %.2f M events/s\n", events,
+             stats.events[EVENT_ARRIVAL], stats.events[EVENT_PARK_COMPLETE], stats.events[EVENT_DEPARTURE], seconds * 1e3,
+             events / seconds / 1e6);
+    print(buffer);
+    snprintf(buffer, BUFFER_SIZE, "  checksum %016llx\n", (unsigned long long)stats.checksum);
+    print(buffer);
+}
+
+// Attendants (attendantsPerType processes per lot and vehicle type) and poolWorkers owner generators are forked
+// and attach to the segment by name; every piece of coordination between them lives in the
+// segment. With crashOwner, the first generator is killed while holding a lot mutex halfway
+// through, and the others carry on through the robust-mutex recovery.
+void processSimulation(double *seconds)
+{
+    int attendantTotal = 2 * lotCount * attendantsPerType;
+    pid_t *attendants = (pid_t *)malloc(attendantTotal * sizeof(pid_t));
+    pid_t *owners = (pid_t *)malloc(poolWorkers * sizeof(pid_t));
+    if (attendants == NULL || owners == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(stdout);
+    for (long i = 0; i < attendantTotal; i++)
+    {
+        attendants[i] = fork();
+        if (attendants[i] < 0)
+        {
+            perror("Failed to fork attendant");
+            exit(EXIT_FAILURE);
+        }
+        if (attendants[i] == 0)
+        {
+            attachMember();
+            carAttendant((void *)i);
+            flushEventLog();
+            detach_shared_memory(segment);
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    pid_t ticker = -1;
+    if (departuresEnabled)
+    {
+        ticker = fork();
+        if (ticker < 0)
+        {
+            perror("Failed to fork departure ticker");
+            exit(EXIT_FAILURE);
+        }
+        if (ticker == 0)
+        {
+            attachMember();
+            departureTicker(NULL);
+            flushEventLog();
+            detach_shared_memory(segment);
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < poolWorkers; i++)
+    {
+        owners[i] = fork();
+        if (owners[i] < 0)
+        {
+            perror("Failed to fork owner generator");
+            exit(EXIT_FAILURE);
+        }
+        if (owners[i] == 0)
+        {
+            attachMember();
+            int generated = 0;
+            for (int id = i; id < vehicleCount; id += poolWorkers)
+            {
+                if (crashOwner && i == 0 && generated == vehicleCount / poolWorkers / 2)
+                {
+                    lock_robust(&parkingLots[0].automobileLock, &segment->header.recovered, NULL, NULL);
+                    raise(SIGKILL);
+                }
+                Vehicle vehicle = {id, rand() % 2}; // 0 for automobile, 1 for pickup
+                parkVehicle(&vehicle);
+                generated++;
+                if (arrivalDelay > 0)
+                    usleep(rand() % arrivalDelay);
+            }
+            flushEventLog();
+            detach_shared_memory(segment);
+            exit(EXIT_SUCCESS);
+        }
+    }
+
+    int crashed = 0;
+    for (int i = 0; i < poolWorkers; i++)
+    {
+        int status;
+        if (waitpid(owners[i], &status, 0) == -1)
+            perror("Failed to wait for owner generator");
+        else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            crashed++;
+            for (int lot = 0; lot < lotCount; lot++)
+            {
+                handoff_reclaim(&parkingLots[lot].automobileHandoff, owners[i]);
+                handoff_reclaim(&parkingLots[lot].pickupHandoff, owners[i]);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (crashed > 0)
+    {
+        char buffer[BUFFER_SIZE];
+        snprintf(buffer, BUFFER_SIZE, "Processes: %d owner generator(s) died, the rest finished\n", crashed);
+        print(buffer);
+    }
+
+    stopAttendants();
+    for (int i = 0; i < attendantTotal; i++)
+        waitpid(attendants[i], NULL, 0);
+    if (ticker > 0)
+        waitpid(ticker, NULL, 0);
+    free(attendants);
+    free(owners);
+}
@@ -10,62 +10,547 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <sched.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "wheel_utils.h"
 
 #define MAX_AUTOMOBILES 8
 #define MAX_PICKUPS 4
 #define BUFFER_SIZE 256
+#define CACHE_LINE_SIZE 64
+#define TASK_QUEUE_CAPACITY 1024
 
-#define SEM_NEW_PICKUP "/sem_newPickup"
-#define SEM_IN_CHARGE_PICKUP "/sem_inChargeforPickup"
-#define SEM_NEW_AUTOMOBILE "/sem_newAutomobile"
-#define SEM_IN_CHARGE_AUTOMOBILE "/sem_inChargeforAutomobile"
-#define SEM_PICKUP_COUNTER_CONTROL "/sem_pickupCounterControl"
-#define SEM_AUTOMOBILE_COUNTER_CONTROL "/sem_automobileCounterControl"
+#define MAX_LOTS 1024
+#define MAX_SPOTS 4096 // per vehicle type in one lot
+#define SPOT_WORDS (MAX_SPOTS / 64)
+#define HANDOFF_TICKETS 32 // power of two, ring positions are masked
+#define MAX_ATTENDANTS 64
+#define WAIT_QUEUE_SLOTS 128
+#define DELAY_BUCKETS 256
 
 #define SHM_PARKING_LOT "/shm_parking_lot"
 
+// Brings the state a robust mutex guards back into shape after its holder died; 0 on success
+typedef int (*LockRepair)(void *state);
+
+// One bit per spot, set while the spot is taken. Allocation is first-fit: the lowest clear bit,
+// found with ctz and claimed with a CAS on its word, so vehicles pack towards low spot ids and
+// keep reusing the same few cache lines.
+typedef struct
+{
+    int spots;
+    atomic_int firstWord; // hint: no free spot below this word, rechecked on a miss
+    atomic_int highest;   // highest spot ever handed out
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t words[SPOT_WORDS];
+} SpotBitmap;
+
+typedef enum
+{
+    TICKET_FREE,    // in the free ring, or on its way back
+    TICKET_HELD,    // taken by an owner, not queued yet
+    TICKET_QUEUED,
+    TICKET_SLEEPING // the owner is blocked on the state futex and needs a wake
+} TicketState;
+
+// The low bits of a ticket's state word hold its TicketState, the rest count the claims of the
+// ticket, so an owner that runs late never mistakes the next claim's state for its own
+#define TICKET_STATE_MASK 7
+
+typedef struct
+{
+    int vehicleId;
+    pid_t owner;       // process holding the ticket, for reclaiming it if that process dies
+    uint64_t postedNs; // when the owner queued the vehicle
+    atomic_int state;  // futex word, set back to TICKET_FREE by the attendant that parked this vehicle
+} HandoffTicket;
+
+typedef struct
+{
+    _Atomic size_t sequence;
+    int ticket;
+} RingCell;
+
+// Vyukov's bounded MPMC queue of ticket numbers. Each cell's sequence says whose turn it is, so
+// producers and consumers claim a position with one CAS and never take a lock. Consumers that
+// find it empty sleep on the wake futex, which producers only bump and wake when the ring goes
+// from empty to non-empty; a consumer that leaves entries behind passes the wake on.
+// Not crash-safe: a process killed between claiming a position and publishing its cell (a few
+// instructions) leaves that cell unfinished, and the ring stalls there for everyone. Likewise an
+// owner killed between popping a free ticket and stamping its pid on it, or between marking it
+// queued and pushing it (handoff_vehicle), loses that ticket for the rest of the run.
+typedef struct
+{
+    _Alignas(CACHE_LINE_SIZE) _Atomic size_t enqueuePos;
+    _Alignas(CACHE_LINE_SIZE) _Atomic size_t dequeuePos;
+    _Alignas(CACHE_LINE_SIZE) atomic_int count; // published entries not yet counted out, may dip below 0
+    atomic_int sleepers;
+    atomic_int wake;
+    RingCell cells[HANDOFF_TICKETS];
+} TicketRing;
+
+// Written only by the attendant it belongs to, read once the run is over
+typedef struct
+{
+    long served;
+    long busyNs;
+    long handoffNs;    // summed from the owner queueing a vehicle to this attendant taking it
+    long maxHandoffNs;
+} AttendantStats;
+
+// Owners of one vehicle type in one lot hand their vehicle to whichever of the type's attendants
+// is free. Each waiting owner holds a ticket with its own futex word, so an owner is released by
+// the attendant that parked its vehicle rather than by whichever attendant finished first.
+typedef struct
+{
+    TicketRing pending; // queued for an attendant, in arrival order
+    TicketRing free;    // tickets no owner holds
+    HandoffTicket tickets[HANDOFF_TICKETS];
+    AttendantStats attendants[MAX_ATTENDANTS];
+} HandoffQueue;
+
+typedef enum
+{
+    WAITER_FREE,
+    WAITER_WAITING,
+    WAITER_GRANTED // a released spot was handed to this waiter
+} WaiterState;
+
+typedef struct
+{
+    int state;
+    sem_t wake;
+} Waiter;
+
+// Owners that found a full lot, oldest first. While anyone is queued a released spot goes
+// straight to the oldest waiter instead of back to the counter, so newcomers cannot overtake.
+typedef struct
+{
+    pthread_mutex_t lock; // robust; guards the fields below and serializes counter releases
+    int head;
+    int count;
+    int order[WAIT_QUEUE_SLOTS]; // waiter slots in arrival order, starting at head
+    Waiter waiters[WAIT_QUEUE_SLOTS];
+} WaitQueue;
+
+// One lot of the campus. The shared segment holds an array of these, each counter on its own
+// cache line, and every lot carries its own process-shared semaphores, robust mutexes and
+// hand-off queues, so lots never contend with each other.
 typedef struct
 {
-    int mFree_automobile;
-    int mFree_pickup;
+    _Alignas(CACHE_LINE_SIZE) atomic_int mFree_automobile;
+    _Alignas(CACHE_LINE_SIZE) atomic_int mFree_pickup;
+    _Alignas(CACHE_LINE_SIZE) sem_t automobileCounterControl;
+    pthread_mutex_t automobileLock;
+    _Alignas(CACHE_LINE_SIZE) sem_t pickupCounterControl;
+    pthread_mutex_t pickupLock;
+    _Alignas(CACHE_LINE_SIZE) HandoffQueue automobileHandoff;
+    _Alignas(CACHE_LINE_SIZE) HandoffQueue pickupHandoff;
+    _Alignas(CACHE_LINE_SIZE) WaitQueue automobileWaiting;
+    _Alignas(CACHE_LINE_SIZE) WaitQueue pickupWaiting;
+    SpotBitmap automobileSpots;
+    SpotBitmap pickupSpots;
 } ParkingLot;
 
+// Queueing delay of every parked vehicle (0 for those that never waited) on a log-linear
+// histogram: exact below 8 us, then 8 buckets per power of two, so percentiles are within 12.5%
+typedef struct
+{
+    atomic_long parked;
+    atomic_long queued;
+    atomic_long abandoned; // patience ran out before a spot was handed over
+    atomic_long balked;    // lot and wait queue both full
+    atomic_long maxDelayUs;
+    atomic_long delayHistogram[DELAY_BUCKETS];
+} WaitStats;
+
+// Parked vehicles waiting to leave live on the segment's timer wheel
+typedef struct
+{
+    pthread_mutex_t lock; // robust, guards the wheel and the counters below
+    long departed;
+    long peakParked;
+    long occupancySum; // parked vehicles summed over every tick, for the time average
+    long ticks;
+} DepartureBoard;
+
+// Run-wide state every attached process sees
+typedef struct
+{
+    int lotCount;
+    int capacity[2]; // spots per lot for automobiles and pickups
+    size_t size;     // whole segment, lots and timer wheel included
+    _Alignas(CACHE_LINE_SIZE) atomic_int stop;
+    atomic_long recovered; // robust locks taken over from a member that died holding them
+    WaitStats waitStats;
+    DepartureBoard departures;
+} SegmentHeader;
+
+// The timer wheel follows the last lot, sized for every spot of every lot
+typedef struct
+{
+    SegmentHeader header;
+    ParkingLot lots[];
+} ParkingSegment;
+
+TimerWheel *segment_wheel(ParkingSegment *segment)
+{
+    return (TimerWheel *)&segment->lots[segment->header.lotCount];
+}
+
+// Lock repair for the departure board (state is the segment); its counters are plain statistics
+int departure_board_repair(void *state)
+{
+    return timer_wheel_repair(segment_wheel((ParkingSegment *)state));
+}
+
+typedef enum
+{
+    ROUTE_HASH,         // a fixed lot per vehicle id, turned away when that lot is full
+    ROUTE_LEAST_LOADED, // the lot with the most free spots of the vehicle's type
+    ROUTE_NEAREST       // the vehicle's home lot, then its neighbours in order until one has space
+} RoutePolicy;
+
 typedef struct
 {
     int id;
     int vehicleType;
 } Vehicle;
 
-ParkingLot *init_shared_memory(const char *shm_name)
+// Bounded FIFO of pending arrivals; a full queue blocks the producer, so memory stays fixed
+typedef struct
+{
+    Vehicle tasks[TASK_QUEUE_CAPACITY];
+    int head;
+    int count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} TaskQueue;
+
+const char *route_names[] = {"hash", "least", "nearest"};
+
+void spot_bitmap_init(SpotBitmap *map, int spots)
+{
+    map->spots = spots;
+    atomic_init(&map->firstWord, 0);
+    atomic_init(&map->highest, -1);
+    for (int i = 0; i < SPOT_WORDS; i++)
+    {
+        // Bits past the last spot stay set, so they are never handed out
+        int first = i * 64;
+        uint64_t taken = first >= spots ? ~0ULL : spots - first < 64 ? ~0ULL << (spots - first) : 0;
+        atomic_init(&map->words[i], taken);
+    }
+}
+
+// Returns the lowest free spot, or -1 when none was found. A concurrent free behind the scan can
+// be missed, so callers holding a reservation retry.
+int spot_alloc(SpotBitmap *map)
+{
+    int words = (map->spots + 63) / 64;
+    int start = atomic_load_explicit(&map->firstWord, memory_order_relaxed);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = pass == 0 ? start : 0; i < words; i++)
+        {
+            uint64_t word = atomic_load_explicit(&map->words[i], memory_order_relaxed);
+            while (~word != 0)
+            {
+                int bit = __builtin_ctzll(~word);
+                if (atomic_compare_exchange_weak_explicit(&map->words[i], &word, word | (1ULL << bit), memory_order_acquire,
+                                                          memory_order_relaxed))
+                {
+                    int spot = i * 64 + bit;
+                    int highest = atomic_load_explicit(&map->highest, memory_order_relaxed);
+                    while (spot > highest && !atomic_compare_exchange_weak(&map->highest, &highest, spot))
+                        ;
+                    return spot;
+                }
+            }
+            int expected = i;
+            atomic_compare_exchange_strong(&map->firstWord, &expected, i + 1);
+        }
+        if (start == 0)
+            break;
+    }
+    return -1;
+}
+
+void spot_free(SpotBitmap *map, int spot)
+{
+    atomic_fetch_and_explicit(&map->words[spot / 64], ~(1ULL << (spot % 64)), memory_order_release);
+    int word = spot / 64;
+    int hint = atomic_load_explicit(&map->firstWord, memory_order_relaxed);
+    while (word < hint && !atomic_compare_exchange_weak(&map->firstWord, &hint, word))
+        ;
+}
+
+int spot_bitmap_used(SpotBitmap *map)
 {
+    int used = 0;
+    for (int i = 0; i < (map->spots + 63) / 64; i++)
+        used += __builtin_popcountll(atomic_load(&map->words[i]));
+    return used - ((map->spots + 63) / 64 * 64 - map->spots);
+}
+
+// Shared, not FUTEX_PRIVATE: the words live in the segment that member processes map too
+static void futex_wait(atomic_int *word, int expected)
+{
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, NULL, NULL, 0); // EAGAIN and EINTR just make the caller recheck
+}
+
+static void futex_wake(atomic_int *word, int count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+void ring_init(TicketRing *ring)
+{
+    atomic_init(&ring->enqueuePos, 0);
+    atomic_init(&ring->dequeuePos, 0);
+    atomic_init(&ring->count, 0);
+    atomic_init(&ring->sleepers, 0);
+    atomic_init(&ring->wake, 0);
+    for (int i = 0; i < HANDOFF_TICKETS; i++)
+        atomic_init(&ring->cells[i].sequence, i);
+}
+
+void ring_wake(TicketRing *ring, int count)
+{
+    atomic_fetch_add(&ring->wake, 1);
+    futex_wake(&ring->wake, count);
+}
+
+// Never fails for lack of room: only HANDOFF_TICKETS tickets exist. The one wait is for a
+// consumer that has claimed the cell one lap back but not yet handed it back.
+void ring_push(TicketRing *ring, int ticket)
+{
+    size_t pos = atomic_load_explicit(&ring->enqueuePos, memory_order_relaxed);
+    RingCell *cell;
+    for (;;)
+    {
+        cell = &ring->cells[pos & (HANDOFF_TICKETS - 1)];
+        intptr_t diff = (intptr_t)atomic_load_explicit(&cell->sequence, memory_order_acquire) - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else
+        {
+            if (diff < 0)
+                sched_yield();
+            pos = atomic_load_explicit(&ring->enqueuePos, memory_order_relaxed);
+        }
+    }
+    cell->ticket = ticket;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    if (atomic_fetch_add(&ring->count, 1) <= 0 && atomic_load(&ring->sleepers) > 0)
+        ring_wake(ring, 1);
+}
+
+// Returns -1 when the ring is empty or the producer of the next cell has not published yet
+int ring_try_pop(TicketRing *ring)
+{
+    size_t pos = atomic_load_explicit(&ring->dequeuePos, memory_order_relaxed);
+    for (;;)
+    {
+        RingCell *cell = &ring->cells[pos & (HANDOFF_TICKETS - 1)];
+        intptr_t diff = (intptr_t)atomic_load_explicit(&cell->sequence, memory_order_acquire) - (intptr_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                int ticket = cell->ticket;
+                atomic_store_explicit(&cell->sequence, pos + HANDOFF_TICKETS, memory_order_release);
+                return ticket;
+            }
+        }
+        else if (diff < 0)
+            return -1;
+        else
+            pos = atomic_load_explicit(&ring->dequeuePos, memory_order_relaxed);
+    }
+}
+
+// Blocks until an entry arrives; returns -1 once stop is set (stop may be NULL). Sleepers
+// announce themselves before the last look at the ring, so a producer either sees them or the
+// look finds its entry.
+int ring_pop(TicketRing *ring, atomic_int *stop)
+{
+    for (;;)
+    {
+        int ticket = ring_try_pop(ring);
+        if (ticket == -1)
+        {
+            int seen = atomic_load(&ring->wake);
+            atomic_fetch_add(&ring->sleepers, 1);
+            ticket = ring_try_pop(ring);
+            int stopping = stop != NULL && atomic_load(stop);
+            if (ticket == -1 && !stopping)
+                futex_wait(&ring->wake, seen);
+            atomic_fetch_sub(&ring->sleepers, 1);
+            if (ticket == -1)
+            {
+                if (stopping)
+                    return -1;
+                continue;
+            }
+        }
+        if (atomic_fetch_sub(&ring->count, 1) > 1 && atomic_load(&ring->sleepers) > 0)
+            ring_wake(ring, 1);
+        return ticket;
+    }
+}
+
+void handoff_init(HandoffQueue *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+    ring_init(&queue->pending);
+    ring_init(&queue->free);
+    for (int i = 0; i < HANDOFF_TICKETS; i++)
+        ring_push(&queue->free, i);
+}
+
+int wait_queue_init(WaitQueue *queue, const pthread_mutexattr_t *attr)
+{
+    memset(queue, 0, sizeof(*queue));
+    for (int i = 0; i < WAIT_QUEUE_SLOTS; i++)
+        if (sem_init(&queue->waiters[i].wake, 1, 0) == -1)
+            return -1;
+    return pthread_mutex_init(&queue->lock, attr) == 0 ? 0 : -1;
+}
+
+void wait_queue_destroy(WaitQueue *queue)
+{
+    for (int i = 0; i < WAIT_QUEUE_SLOTS; i++)
+        sem_destroy(&queue->waiters[i].wake);
+    pthread_mutex_destroy(&queue->lock);
+}
+
+ParkingSegment *init_shared_memory(const char *shm_name, int lotCount, int automobileSpots, int pickupSpots)
+{
+    int spots = lotCount * (automobileSpots + pickupSpots);
+    size_t size = sizeof(ParkingSegment) + lotCount * sizeof(ParkingLot) + timer_wheel_size(spots);
     int shm_fd = shm_open(shm_name, O_CREAT | O_RDWR, 0666);
     if (shm_fd == -1)
     {
         perror("Failed to create shared memory");
         exit(EXIT_FAILURE);
     }
-    if (ftruncate(shm_fd, sizeof(ParkingLot)) == -1)
+    if (ftruncate(shm_fd, size) == -1)
     {
         perror("Failed to set size of shared memory");
         exit(EXIT_FAILURE);
     }
-    ParkingLot *shm_ptr = (ParkingLot *)mmap(0, sizeof(ParkingLot), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    ParkingSegment *shm_ptr = (ParkingSegment *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
     if (shm_ptr == MAP_FAILED)
     {
         perror("Failed to map shared memory");
         exit(EXIT_FAILURE);
     }
-    shm_ptr->mFree_automobile = MAX_AUTOMOBILES;
-    shm_ptr->mFree_pickup = MAX_PICKUPS;
+    shm_ptr->header.lotCount = lotCount;
+    shm_ptr->header.capacity[0] = automobileSpots;
+    shm_ptr->header.capacity[1] = pickupSpots;
+    shm_ptr->header.size = size;
+    atomic_init(&shm_ptr->header.stop, 0);
+    atomic_init(&shm_ptr->header.recovered, 0);
+    memset(&shm_ptr->header.waitStats, 0, sizeof(WaitStats));
+    memset(&shm_ptr->header.departures, 0, sizeof(DepartureBoard));
+    timer_wheel_init(segment_wheel(shm_ptr), spots);
+
+    // Robust: if a process dies holding a lot lock, the next locker gets EOWNERDEAD instead of hanging
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    if (pthread_mutex_init(&shm_ptr->header.departures.lock, &attr) != 0)
+    {
+        fprintf(stderr, "Failed to initialize departure mutex\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < lotCount; i++)
+    {
+        ParkingLot *lot = &shm_ptr->lots[i];
+        atomic_init(&lot->mFree_automobile, automobileSpots);
+        atomic_init(&lot->mFree_pickup, pickupSpots);
+        spot_bitmap_init(&lot->automobileSpots, automobileSpots);
+        spot_bitmap_init(&lot->pickupSpots, pickupSpots);
+        handoff_init(&lot->automobileHandoff);
+        handoff_init(&lot->pickupHandoff);
+        if (sem_init(&lot->automobileCounterControl, 1, 1) == -1 || sem_init(&lot->pickupCounterControl, 1, 1) == -1 ||
+            wait_queue_init(&lot->automobileWaiting, &attr) == -1 || wait_queue_init(&lot->pickupWaiting, &attr) == -1)
+        {
+            perror("Failed to initialize lot semaphores");
+            exit(EXIT_FAILURE);
+        }
+        if (pthread_mutex_init(&lot->automobileLock, &attr) != 0 || pthread_mutex_init(&lot->pickupLock, &attr) != 0)
+        {
+            fprintf(stderr, "Failed to initialize lot mutexes\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_mutexattr_destroy(&attr);
     return shm_ptr;
 }
 
-void free_shared_memory(ParkingLot *shm_ptr, const char *shm_name)
+// Maps an existing segment by name, as a separately started member process would
+ParkingSegment *attach_shared_memory(const char *shm_name)
 {
-    if (munmap(shm_ptr, sizeof(ParkingLot)) == -1)
+    int shm_fd = shm_open(shm_name, O_RDWR, 0);
+    if (shm_fd == -1)
+    {
+        perror("Failed to open shared memory");
+        exit(EXIT_FAILURE);
+    }
+    struct stat st;
+    if (fstat(shm_fd, &st) == -1)
+    {
+        perror("Failed to stat shared memory");
+        exit(EXIT_FAILURE);
+    }
+    ParkingSegment *shm_ptr = (ParkingSegment *)mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+    if (shm_ptr == MAP_FAILED)
+    {
+        perror("Failed to map shared memory");
+        exit(EXIT_FAILURE);
+    }
+    return shm_ptr;
+}
+
+void detach_shared_memory(ParkingSegment *shm_ptr)
+{
+    if (munmap(shm_ptr, shm_ptr->header.size) == -1)
     {
         perror("Failed to unmap shared memory");
     }
+}
+
+void free_shared_memory(ParkingSegment *shm_ptr, const char *shm_name)
+{
+    int lotCount = shm_ptr->header.lotCount;
+    for (int i = 0; i < lotCount; i++)
+    {
+        ParkingLot *lot = &shm_ptr->lots[i];
+        sem_destroy(&lot->automobileCounterControl);
+        sem_destroy(&lot->pickupCounterControl);
+        wait_queue_destroy(&lot->automobileWaiting);
+        wait_queue_destroy(&lot->pickupWaiting);
+        pthread_mutex_destroy(&lot->automobileLock);
+        pthread_mutex_destroy(&lot->pickupLock);
+    }
+    pthread_mutex_destroy(&shm_ptr->header.departures.lock);
+    detach_shared_memory(shm_ptr);
     if (shm_unlink(shm_name) == -1)
     {
         perror("Failed to unlink shared memory");
@@ -74,6 +559,7 @@ void free_shared_memory(ParkingLot *shm_ptr, const char *shm_name)
 
 sem_t *init_semaphore(const char *sem_name, unsigned int value)
 {
+    sem_unlink(sem_name); // drop a semaphore left behind by an interrupted run so value applies
     sem_t *sem_ptr = sem_open(sem_name, O_CREAT, 0666, value);
     if (sem_ptr == SEM_FAILED)
     {
@@ -95,6 +581,343 @@ void free_semaphore(sem_t *sem_ptr, const char *sem_name)
     }
 }
 
+int parse_route_policy(const char *name)
+{
+    for (int i = 0; i < (int)(sizeof(route_names) / sizeof(route_names[0])); i++)
+        if (strcmp(name, route_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+// Per-type views of a lot; vehicleType is 0 for automobile, 1 for pickup
+atomic_int *lot_counter(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->mFree_automobile : &lot->mFree_pickup;
+}
+
+sem_t *lot_counter_control(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->automobileCounterControl : &lot->pickupCounterControl;
+}
+
+pthread_mutex_t *lot_lock(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->automobileLock : &lot->pickupLock;
+}
+
+HandoffQueue *lot_handoff(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->automobileHandoff : &lot->pickupHandoff;
+}
+
+SpotBitmap *lot_spots(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->automobileSpots : &lot->pickupSpots;
+}
+
+WaitQueue *lot_wait_queue(ParkingLot *lot, int vehicleType)
+{
+    return vehicleType == 0 ? &lot->automobileWaiting : &lot->pickupWaiting;
+}
+
+// Stable pseudo-random lot for a vehicle id (the hash policy's lot, the nearest policy's entrance)
+int home_lot(int vehicleId, int lotCount)
+{
+    uint64_t z = (uint64_t)vehicleId * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (int)((z ^ (z >> 31)) % (uint64_t)lotCount);
+}
+
+// Takes one spot if any is free; returns 1 and the spots left after it, or 0 when full
+int reserve_spot(atomic_int *counter, int *remaining)
+{
+    int expected = atomic_load_explicit(counter, memory_order_relaxed);
+    while (expected > 0)
+    {
+        if (atomic_compare_exchange_weak_explicit(counter, &expected, expected - 1, memory_order_acq_rel, memory_order_relaxed))
+        {
+            *remaining = expected - 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Gives a spot back; returns the spots available afterwards
+int release_spot(atomic_int *counter)
+{
+    return atomic_fetch_add_explicit(counter, 1, memory_order_acq_rel) + 1;
+}
+
+void task_queue_init(TaskQueue *queue)
+{
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->notEmpty, NULL);
+    pthread_cond_init(&queue->notFull, NULL);
+}
+
+void task_queue_push(TaskQueue *queue, Vehicle task)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == TASK_QUEUE_CAPACITY)
+        pthread_cond_wait(&queue->notFull, &queue->lock);
+    queue->tasks[(queue->head + queue->count) % TASK_QUEUE_CAPACITY] = task;
+    queue->count++;
+    pthread_cond_signal(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Returns 1 with the next task, or 0 once the queue is closed and drained
+int task_queue_pop(TaskQueue *queue, Vehicle *task)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->notEmpty, &queue->lock);
+    if (queue->count == 0)
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+    *task = queue->tasks[queue->head];
+    queue->head = (queue->head + 1) % TASK_QUEUE_CAPACITY;
+    queue->count--;
+    pthread_cond_signal(&queue->notFull);
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+void task_queue_close(TaskQueue *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void task_queue_destroy(TaskQueue *queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->notEmpty);
+    pthread_cond_destroy(&queue->notFull);
+}
+
+// Locks a robust mutex. When the previous owner died holding it, repair first brings the state
+// the mutex guards back into shape, and only then is the lock marked consistent and counted.
+// repair may be NULL for state a holder changes with a single store, such as a lot counter. If
+// repair fails the mutex is left unrecoverable, so this and every later locker exit rather than
+// work on torn state.
+void lock_robust(pthread_mutex_t *mutex, atomic_long *recovered, LockRepair repair, void *state)
+{
+    int rc = pthread_mutex_lock(mutex);
+    if (rc == EOWNERDEAD)
+    {
+        if (repair != NULL && repair(state) == -1)
+        {
+            pthread_mutex_unlock(mutex);
+            fprintf(stderr, "Failed to repair state left by a dead lock holder\n");
+            exit(EXIT_FAILURE);
+        }
+        pthread_mutex_consistent(mutex);
+        atomic_fetch_add(recovered, 1);
+    }
+    else if (rc != 0)
+    {
+        errno = rc;
+        perror("Failed to lock mutex");
+        exit(EXIT_FAILURE);
+    }
+}
+
+uint64_t monotonic_ns()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Owner side: queues the vehicle and blocks until an attendant has parked it. The ticket is
+// stamped with the owner's pid so handoff_reclaim can give it back if the owner dies holding it;
+// see TicketRing for the window that is not recovered. The attendant returns the ticket, so the
+// owner never touches it again once released and cannot die halfway through handing it back.
+void handoff_vehicle(HandoffQueue *queue, int vehicleId)
+{
+    int ticket = ring_pop(&queue->free, NULL);
+    HandoffTicket *entry = &queue->tickets[ticket];
+    entry->owner = getpid();
+    int claim = (int)(((unsigned)atomic_load(&entry->state) | TICKET_STATE_MASK) + 1);
+    atomic_store(&entry->state, claim | TICKET_HELD);
+    entry->vehicleId = vehicleId;
+    entry->postedNs = monotonic_ns();
+    atomic_store(&entry->state, claim | TICKET_QUEUED);
+    ring_push(&queue->pending, ticket);
+
+    // Only sleep if the attendant is not done yet; it makes the wake syscall only for sleepers
+    int state = claim | TICKET_QUEUED;
+    if (atomic_compare_exchange_strong(&entry->state, &state, claim | TICKET_SLEEPING))
+        while (atomic_load(&entry->state) == (claim | TICKET_SLEEPING))
+            futex_wait(&entry->state, claim | TICKET_SLEEPING);
+}
+
+// Attendant side: waits for the oldest queued vehicle and returns its ticket, or -1 once stop is
+// set (shutdown wakes every sleeping attendant)
+int handoff_take(HandoffQueue *queue, atomic_int *stop)
+{
+    return ring_pop(&queue->pending, stop);
+}
+
+// Releases the owner and returns its ticket to the free ring. Only the attendant and the owner
+// write the state of a queued ticket, and both keep its claim count.
+void handoff_complete(HandoffQueue *queue, int ticket)
+{
+    HandoffTicket *entry = &queue->tickets[ticket];
+    int claim = atomic_load(&entry->state) & ~TICKET_STATE_MASK;
+    if ((atomic_exchange(&entry->state, claim | TICKET_FREE) & TICKET_STATE_MASK) == TICKET_SLEEPING)
+        futex_wake(&entry->state, 1);
+    ring_push(&queue->free, ticket);
+}
+
+// Called by the parent once owner has died: returns the tickets it held but never queued to the
+// free ring, so the queue does not run dry. Queued ones come back through their attendant.
+// Returns the number of tickets found.
+int handoff_reclaim(HandoffQueue *queue, pid_t owner)
+{
+    int found = 0;
+    for (int ticket = 0; ticket < HANDOFF_TICKETS; ticket++)
+    {
+        HandoffTicket *entry = &queue->tickets[ticket];
+        int state = atomic_load(&entry->state); // before owner, which a new claim writes first
+        if ((state & TICKET_STATE_MASK) == TICKET_FREE || entry->owner != owner)
+            continue;
+        found++;
+        if ((state & TICKET_STATE_MASK) == TICKET_HELD)
+        {
+            atomic_store(&entry->state, (state & ~TICKET_STATE_MASK) | TICKET_FREE);
+            ring_push(&queue->free, ticket);
+        }
+    }
+    return found;
+}
+
+// The wait_queue_* calls below expect the queue lock to be held
+
+// Appends a waiter and returns its slot, or -1 when capacity owners are already queued
+int wait_queue_enqueue(WaitQueue *queue, int capacity)
+{
+    if (queue->count >= capacity)
+        return -1;
+    for (int slot = 0; slot < WAIT_QUEUE_SLOTS; slot++)
+    {
+        if (queue->waiters[slot].state == WAITER_FREE)
+        {
+            queue->waiters[slot].state = WAITER_WAITING;
+            queue->order[(queue->head + queue->count) % WAIT_QUEUE_SLOTS] = slot;
+            queue->count++;
+            return slot;
+        }
+    }
+    return -1; // every slot still held by a granted owner that has not woken up yet
+}
+
+// Takes a waiter that gave up out of the queue, keeping the others in order
+void wait_queue_remove(WaitQueue *queue, int slot)
+{
+    int i = 0;
+    while (i < queue->count && queue->order[(queue->head + i) % WAIT_QUEUE_SLOTS] != slot)
+        i++;
+    for (; i + 1 < queue->count; i++)
+        queue->order[(queue->head + i) % WAIT_QUEUE_SLOTS] = queue->order[(queue->head + i + 1) % WAIT_QUEUE_SLOTS];
+    queue->count--;
+}
+
+// Lock repair for a wait queue (state is the queue). The waiter states are the ground truth: if
+// the order list is torn it is rebuilt from the WAITING slots, losing only their arrival order.
+int wait_queue_repair(void *state)
+{
+    WaitQueue *queue = (WaitQueue *)state;
+    int listed[WAIT_QUEUE_SLOTS] = {0};
+    int valid = queue->head >= 0 && queue->head < WAIT_QUEUE_SLOTS && queue->count >= 0 && queue->count <= WAIT_QUEUE_SLOTS;
+    for (int i = 0; valid && i < queue->count; i++)
+    {
+        int slot = queue->order[(queue->head + i) % WAIT_QUEUE_SLOTS];
+        valid = slot >= 0 && slot < WAIT_QUEUE_SLOTS && !listed[slot] && queue->waiters[slot].state == WAITER_WAITING;
+        if (valid)
+            listed[slot] = 1;
+    }
+    for (int slot = 0; valid && slot < WAIT_QUEUE_SLOTS; slot++)
+        valid = queue->waiters[slot].state != WAITER_WAITING || listed[slot];
+    if (valid)
+        return 0;
+
+    queue->head = 0;
+    queue->count = 0;
+    for (int slot = 0; slot < WAIT_QUEUE_SLOTS; slot++)
+        if (queue->waiters[slot].state == WAITER_WAITING)
+            queue->order[queue->count++] = slot;
+    return 0;
+}
+
+// Hands a released spot to the oldest waiter; returns 0 when nobody is waiting
+int wait_queue_grant(WaitQueue *queue)
+{
+    if (queue->count == 0)
+        return 0;
+    int slot = queue->order[queue->head];
+    queue->head = (queue->head + 1) % WAIT_QUEUE_SLOTS;
+    queue->count--;
+    queue->waiters[slot].state = WAITER_GRANTED;
+    sem_post(&queue->waiters[slot].wake);
+    return 1;
+}
+
+int delay_bucket(long us)
+{
+    if (us < 8)
+        return us < 0 ? 0 : (int)us;
+    int exponent = 63 - __builtin_clzl((unsigned long)us);
+    int bucket = (exponent - 2) * 8 + (int)((us >> (exponent - 3)) & 7);
+    return bucket < DELAY_BUCKETS ? bucket : DELAY_BUCKETS - 1;
+}
+
+// Largest delay that lands in the bucket
+long delay_bucket_limit(int bucket)
+{
+    if (bucket < 8)
+        return bucket;
+    int exponent = bucket / 8 + 2;
+    return ((8L + bucket % 8 + 1) << (exponent - 3)) - 1;
+}
+
+void wait_stats_record(WaitStats *stats, long delayUs)
+{
+    atomic_fetch_add(&stats->parked, 1);
+    atomic_fetch_add(&stats->delayHistogram[delay_bucket(delayUs)], 1);
+    long max = atomic_load(&stats->maxDelayUs);
+    while (delayUs > max && !atomic_compare_exchange_weak(&stats->maxDelayUs, &max, delayUs))
+        ;
+}
+
+// Upper bound of the q-quantile (0 < q <= 1) of the recorded delays
+long wait_stats_percentile(WaitStats *stats, double q)
+{
+    long total = atomic_load(&stats->parked);
+    long rank = (long)(q * total + 0.999999), seen = 0;
+    for (int bucket = 0; bucket < DELAY_BUCKETS; bucket++)
+    {
+        seen += atomic_load(&stats->delayHistogram[bucket]);
+        if (seen >= rank && seen > 0)
+        {
+            long limit = delay_bucket_limit(bucket);
+            long max = atomic_load(&stats->maxDelayUs);
+            return limit < max ? limit : max;
+        }
+    }
+    return 0;
+}
+
 void print(const char *message)
 {
     ssize_t bytes_written;
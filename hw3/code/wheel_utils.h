@@ -0,0 +1,185 @@
+#ifndef _WHEEL_UTILS_H
+#define _WHEEL_UTILS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_SPAN (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) // ticks the top level reaches ahead
+#define WHEEL_NIL -1
+
+typedef struct
+{
+    uint64_t expires; // absolute tick
+    int next;
+    int payload;
+} TimerNode;
+
+// Hierarchical timing wheel: level l holds timers due within 64^(l+1) ticks, bucketed by their
+// l-th base-64 digit. Scheduling and expiring are O(1); a timer is moved down a level at most
+// WHEEL_LEVELS - 1 times on its way to level 0. Links are node indices rather than pointers,
+// so a wheel can sit in shared memory mapped at different addresses.
+typedef struct
+{
+    uint64_t now; // current tick
+    int capacity;
+    int freeHead;
+    int firingHead; // batch handed out by the last advance, until it is released
+    int firingTail;
+    long pending;
+    int slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    TimerNode nodes[];
+} TimerWheel;
+
+size_t timer_wheel_size(int capacity)
+{
+    return sizeof(TimerWheel) + capacity * sizeof(TimerNode);
+}
+
+void timer_wheel_init(TimerWheel *wheel, int capacity)
+{
+    wheel->now = 0;
+    wheel->capacity = capacity;
+    wheel->pending = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+            wheel->slots[level][slot] = WHEEL_NIL;
+    for (int i = 0; i < capacity; i++)
+        wheel->nodes[i].next = i + 1 < capacity ? i + 1 : WHEEL_NIL;
+    wheel->freeHead = capacity > 0 ? 0 : WHEEL_NIL;
+    wheel->firingHead = WHEEL_NIL;
+    wheel->firingTail = WHEEL_NIL;
+}
+
+static void timer_wheel_link(TimerWheel *wheel, int node)
+{
+    uint64_t expires = wheel->nodes[node].expires;
+    uint64_t delta = expires > wheel->now ? expires - wheel->now : 0;
+    if (delta >= WHEEL_SPAN)
+    {
+        // Beyond the top level: park it at the far edge, it is re-filed when that slot cascades
+        delta = WHEEL_SPAN - 1;
+        expires = wheel->now + delta;
+    }
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1))))
+        level++;
+    int slot = delta == 0 ? (int)(wheel->now & WHEEL_MASK) : (int)((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    wheel->nodes[node].next = wheel->slots[level][slot];
+    wheel->slots[level][slot] = node;
+}
+
+// Returns the timer's node, or WHEEL_NIL when every node is in use. A zero delay fires on the
+// next tick.
+int timer_wheel_schedule(TimerWheel *wheel, uint64_t delayTicks, int payload)
+{
+    int node = wheel->freeHead;
+    if (node == WHEEL_NIL)
+        return WHEEL_NIL;
+    wheel->freeHead = wheel->nodes[node].next;
+    wheel->nodes[node].expires = wheel->now + (delayTicks > 0 ? delayTicks : 1);
+    wheel->nodes[node].payload = payload;
+    timer_wheel_link(wheel, node);
+    wheel->pending++;
+    return node;
+}
+
+static void timer_wheel_cascade(TimerWheel *wheel, int level)
+{
+    int slot = (int)((wheel->now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    int node = wheel->slots[level][slot];
+    wheel->slots[level][slot] = WHEEL_NIL;
+    while (node != WHEEL_NIL)
+    {
+        int next = wheel->nodes[node].next;
+        timer_wheel_link(wheel, node);
+        node = next;
+    }
+}
+
+// Moves one tick ahead and unlinks the timers due at the new tick. Returns the first of them
+// (chained through next) or WHEEL_NIL, and the last one in *tail; the nodes stay allocated until
+// handed back with timer_wheel_release, so the caller can walk them without holding a lock.
+int timer_wheel_advance(TimerWheel *wheel, int *tail)
+{
+    wheel->now++;
+    int level = 1;
+    while (level < WHEEL_LEVELS && (wheel->now & ((1ULL << (WHEEL_BITS * level)) - 1)) == 0)
+        level++;
+    for (int l = level - 1; l >= 1; l--)
+        timer_wheel_cascade(wheel, l);
+
+    int slot = (int)(wheel->now & WHEEL_MASK);
+    int head = wheel->slots[0][slot];
+    wheel->slots[0][slot] = WHEEL_NIL;
+    *tail = WHEEL_NIL;
+    for (int node = head; node != WHEEL_NIL; node = wheel->nodes[node].next)
+    {
+        *tail = node;
+        wheel->pending--;
+    }
+    wheel->firingHead = head;
+    wheel->firingTail = *tail;
+    return head;
+}
+
+void timer_wheel_release(TimerWheel *wheel, int head, int tail)
+{
+    wheel->firingHead = WHEEL_NIL;
+    wheel->firingTail = WHEEL_NIL;
+    if (head == WHEEL_NIL)
+        return;
+    wheel->nodes[tail].next = wheel->freeHead;
+    wheel->freeHead = head;
+}
+
+// Restores the links after whoever held the wheel's lock died mid-update. Slot chains are cut at
+// the first bad or repeated index, nodes of the firing batch stay with the ticker, and every
+// other node goes back on a rebuilt free list, so a timer whose scheduling was cut short is
+// dropped. Returns -1 only when there is no memory for the walk.
+int timer_wheel_repair(TimerWheel *wheel)
+{
+    char *reachable = (char *)calloc(wheel->capacity > 0 ? wheel->capacity : 1, 1);
+    if (reachable == NULL)
+        return -1;
+    long pending = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++)
+        for (int slot = 0; slot < WHEEL_SLOTS; slot++)
+        {
+            int *link = &wheel->slots[level][slot];
+            while (*link != WHEEL_NIL)
+            {
+                int node = *link;
+                if (node < 0 || node >= wheel->capacity || reachable[node])
+                {
+                    *link = WHEEL_NIL;
+                    break;
+                }
+                reachable[node] = 1;
+                pending++;
+                link = &wheel->nodes[node].next;
+            }
+        }
+    for (int node = wheel->firingHead; node >= 0 && node < wheel->capacity && !reachable[node]; node = wheel->nodes[node].next)
+    {
+        reachable[node] = 1;
+        if (node == wheel->firingTail)
+            break;
+    }
+    wheel->freeHead = WHEEL_NIL;
+    for (int node = wheel->capacity - 1; node >= 0; node--)
+        if (!reachable[node])
+        {
+            wheel->nodes[node].next = wheel->freeHead;
+            wheel->freeHead = node;
+        }
+    wheel->pending = pending;
+    free(reachable);
+    return 0;
+}
+
+#endif